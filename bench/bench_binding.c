@@ -0,0 +1,325 @@
+/*
+ * bench/bench_binding.c
+ *
+ * Copyright (C) 2014-2015 Benny Holmgren
+ *
+ * This file is part of PyCLIgen.
+ *
+ * PyCLIgen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ *  PyCLIgen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along wth PyCLIgen; see the file LICENSE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmark harness for the binding overhead. It embeds Python to run the
+ * driver, bench_binding.py, with the Python allocators and libc malloc
+ * wrapped to count allocations, and provides the driver with the module
+ * _benchalloc:
+ *
+ *   counts()             Allocation counts (python, malloc) so far
+ *   cvec(n)              A capsule of a C cvec of n int32 variables
+ *   native(case, loops)  Run a libcligen baseline case, returning total ns
+ *
+ * Usage: bench_binding [script.py] [driver options]
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <cligen/cligen.h>
+
+#define BENCH_SCRIPT  "bench_binding.py"
+
+static uint64_t bench_pyallocs;  /* Python allocator calls */
+static uint64_t bench_mallocs;   /* libc malloc calls, including Python's */
+
+static PyMemAllocatorEx bench_orig[3];
+
+/*
+ * Python allocators, counting and calling the original ones
+ */
+static void *
+bench_py_malloc(void *ctx, size_t size)
+{
+    PyMemAllocatorEx *a = ctx;
+
+    bench_pyallocs++;
+    return a->malloc(a->ctx, size);
+}
+
+static void *
+bench_py_calloc(void *ctx, size_t nelem, size_t elsize)
+{
+    PyMemAllocatorEx *a = ctx;
+
+    bench_pyallocs++;
+    return a->calloc(a->ctx, nelem, elsize);
+}
+
+static void *
+bench_py_realloc(void *ctx, void *ptr, size_t size)
+{
+    PyMemAllocatorEx *a = ctx;
+
+    bench_pyallocs++;
+    return a->realloc(a->ctx, ptr, size);
+}
+
+static void
+bench_py_free(void *ctx, void *ptr)
+{
+    PyMemAllocatorEx *a = ctx;
+
+    a->free(a->ctx, ptr);
+}
+
+static void
+bench_hook_allocators(void)
+{
+    int i;
+    PyMemAllocatorDomain domains[3] = {
+	PYMEM_DOMAIN_RAW, PYMEM_DOMAIN_MEM, PYMEM_DOMAIN_OBJ
+    };
+    PyMemAllocatorEx hook;
+
+    for (i = 0; i < 3; i++) {
+	PyMem_GetAllocator(domains[i], &bench_orig[i]);
+	hook.ctx = &bench_orig[i];
+	hook.malloc = bench_py_malloc;
+	hook.calloc = bench_py_calloc;
+	hook.realloc = bench_py_realloc;
+	hook.free = bench_py_free;
+	PyMem_SetAllocator(domains[i], &hook);
+    }
+}
+
+#ifdef __GLIBC__
+/*
+ * libc allocator, interposed to count the allocations of libcligen too
+ */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nelem, size_t elsize);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *
+malloc(size_t size)
+{
+    bench_mallocs++;
+    return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nelem, size_t elsize)
+{
+    bench_mallocs++;
+    return __libc_calloc(nelem, elsize);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+    bench_mallocs++;
+    return __libc_realloc(ptr, size);
+}
+#endif /* __GLIBC__ */
+
+static uint64_t
+bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static PyObject *
+bench_counts(PyObject *self)
+{
+    return Py_BuildValue("(KK)", (unsigned long long)bench_pyallocs,
+			 (unsigned long long)bench_mallocs);
+}
+
+static void
+bench_cvec_free(PyObject *Capsule)
+{
+    cvec_free((cvec *)PyCapsule_GetPointer(Capsule, NULL));
+}
+
+static PyObject *
+bench_cvec(PyObject *self, PyObject *args)
+{
+    int i;
+    int n;
+    char name[16];
+    cvec *vr;
+    cg_var *cv;
+    PyObject *Capsule;
+
+    if (!PyArg_ParseTuple(args, "i", &n))
+	return NULL;
+    if ((vr = cvec_new(n)) == NULL)
+	return PyErr_NoMemory();
+    for (i = 0, cv = NULL; (cv = cvec_each(vr, cv)); i++) {
+	snprintf(name, sizeof(name), "v%d", i);
+	cv_type_set(cv, CGV_INT32);
+	cv_name_set(cv, name);
+	cv_int32_set(cv, i);
+    }
+    if ((Capsule = PyCapsule_New(vr, NULL, bench_cvec_free)) == NULL)
+	cvec_free(vr);
+
+    return Capsule;
+}
+
+/*
+ * libcligen baselines of what the binding wraps
+ */
+static PyObject *
+bench_native(PyObject *self, PyObject *args)
+{
+    long i;
+    long loops;
+    char *name;
+    uint64_t t0;
+    volatile int32_t sink = 0;
+    cg_var *cv = NULL;
+    cvec *vr;
+
+    if (!PyArg_ParseTuple(args, "sl", &name, &loops))
+	return NULL;
+
+    if (strcmp(name, "cv_int32") == 0 || strcmp(name, "cv_string") == 0) {
+	if ((cv = cv_new(strcmp(name, "cv_int32") ? CGV_STRING : CGV_INT32)) == NULL)
+	    return PyErr_NoMemory();
+    }
+
+    t0 = bench_now();
+    if (strcmp(name, "cv_new") == 0) {
+	for (i = 0; i < loops; i++) {
+	    if ((cv = cv_new(CGV_INT32)) == NULL)
+		return PyErr_NoMemory();
+	    cv_free(cv);
+	}
+	cv = NULL;
+    }
+    else if (strcmp(name, "cv_int32") == 0) {
+	for (i = 0; i < loops; i++) {
+	    cv_int32_set(cv, i);
+	    sink += cv_int32_get(cv);
+	}
+    }
+    else if (strcmp(name, "cv_string") == 0) {
+	for (i = 0; i < loops; i++) {
+	    cv_string_set(cv, "abc");
+	    sink += cv_string_get(cv)[0];
+	}
+    }
+    else if (strcmp(name, "cvec_new") == 0) {
+	for (i = 0; i < loops; i++) {
+	    if ((vr = cvec_new(8)) == NULL)
+		return PyErr_NoMemory();
+	    cvec_free(vr);
+	}
+    }
+    else {
+	PyErr_Format(PyExc_ValueError, "unknown native case: %s", name);
+	return NULL;
+    }
+    t0 = bench_now() - t0;
+    if (cv)
+	cv_free(cv);
+
+    return PyLong_FromUnsignedLongLong(t0);
+}
+
+static PyMethodDef bench_methods[] = {
+    {"counts", (PyCFunction)bench_counts, METH_NOARGS,
+     "Get the allocation counts (python, malloc)"
+    },
+    {"cvec", (PyCFunction)bench_cvec, METH_VARARGS,
+     "Create a capsule of a cvec of n int32 variables"
+    },
+    {"native", (PyCFunction)bench_native, METH_VARARGS,
+     "Run a libcligen baseline case, returning total ns"
+    },
+    {NULL}  /* Sentinel */
+};
+
+static struct PyModuleDef bench_module = {
+    PyModuleDef_HEAD_INIT,
+    "_benchalloc",
+    "Allocation counting and libcligen baselines for bench_binding.py",
+    -1,
+    bench_methods,
+};
+
+static PyObject *
+PyInit__benchalloc(void)
+{
+    return PyModule_Create(&bench_module);
+}
+
+int
+main(int argc, char **argv)
+{
+    int i;
+    int nargc = 0;
+    char *script = NULL;
+    char *slash;
+    char **nargv;
+    PyStatus status;
+    PyConfig config;
+
+    /* Default to the driver next to the executable */
+    if (argc > 1 && strlen(argv[1]) > 3 &&
+	strcmp(argv[1] + strlen(argv[1]) - 3, ".py") == 0)
+	script = argv[1];
+    else if ((script = malloc(strlen(argv[0]) + sizeof(BENCH_SCRIPT))) != NULL) {
+	strcpy(script, argv[0]);
+	slash = strrchr(script, '/');
+	strcpy(slash ? slash + 1 : script, BENCH_SCRIPT);
+    }
+    if (script == NULL || (nargv = calloc(argc + 2, sizeof(char *))) == NULL) {
+	perror("bench_binding");
+	return 1;
+    }
+    nargv[nargc++] = argv[0];
+    nargv[nargc++] = script;
+    for (i = (script == argv[1]) ? 2 : 1; i < argc; i++)
+	nargv[nargc++] = argv[i];
+
+    if (PyImport_AppendInittab("_benchalloc", PyInit__benchalloc) < 0) {
+	fprintf(stderr, "bench_binding: cannot add _benchalloc\n");
+	return 1;
+    }
+    PyConfig_InitPythonConfig(&config);
+    status = PyConfig_SetBytesArgv(&config, nargc, nargv);
+    if (PyStatus_Exception(status))
+	goto fail;
+    bench_hook_allocators();
+    status = Py_InitializeFromConfig(&config);
+    if (PyStatus_Exception(status))
+	goto fail;
+    PyConfig_Clear(&config);
+
+    return Py_RunMain();
+
+ fail:
+    PyConfig_Clear(&config);
+    Py_ExitStatusException(status);
+}
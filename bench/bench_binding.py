@@ -0,0 +1,237 @@
+#!/usr/bin/env python
+#
+#  pycligen binding micro-benchmarks
+#
+# Copyright (C) 2014-2015 Benny Holmgren
+#
+#  This file is part of PyCLIgen.
+#
+#  PyPyCLIgen is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation; either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  PyCLIgen is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with PyCLIgen; see the file LICENSE.
+
+"""Micro-benchmarks of the overhead of the pycligen binding
+
+Each benchmark runs an operation in a loop and reports the time per
+operation, less the cost of the empty loop, and, when run by the
+bench_binding harness, the number of Python allocator and libc malloc calls
+per operation. Run 'make bench', or 'python3 bench_binding.py' for times only.
+
+Results can be saved with --save and checked against a saved run with
+--compare, which fails if any benchmark got slower than --threshold percent.
+"""
+
+import os
+import gc
+import sys
+import json
+import time
+import argparse
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..'))
+
+from cligen import *
+
+try:
+    import _benchalloc
+except ImportError:
+    _benchalloc = None
+
+
+# Callbacks, looked up in __main__ by CLIgen
+def bench_cb(cgen, vr, arg):
+    return 0
+
+def bench_expand(cgen, name, vr, arg):
+    return [{'name': 'eth0', 'help': 'Ethernet 0'},
+            {'name': 'eth1', 'help': 'Ethernet 1'}]
+
+
+SYNTAX = """
+noargs, bench_cb();
+args <a:int32> <b:string> <c:ipv4addr> <d:bool>, bench_cb();
+expand <ifname:string bench_expand()>, bench_cb();
+"""
+
+# Typed accessors: type, value, getter, setter
+ACCESSORS = [
+    (CGV_INT8, '8', 'int8_get', 'int8_set'),
+    (CGV_INT16, '16', 'int16_get', 'int16_set'),
+    (CGV_INT32, '32', 'int32_get', 'int32_set'),
+    (CGV_INT64, '64', 'int64_get', 'int64_set'),
+    (CGV_UINT8, '8', 'uint8_get', 'uint8_set'),
+    (CGV_UINT16, '16', 'uint16_get', 'uint16_set'),
+    (CGV_UINT32, '32', 'uint32_get', 'uint32_set'),
+    (CGV_UINT64, '64', 'uint64_get', 'uint64_set'),
+    (CGV_DEC64, '1.5', 'dec64_get', 'dec64_set'),
+    (CGV_BOOL, 'true', 'bool_get', 'bool_set'),
+    (CGV_STRING, 'abc', 'string_get', 'string_set'),
+    (CGV_IPV4ADDR, '10.0.0.1', 'ipv4addr_get', 'ipv4addr_set'),
+    (CGV_IPV6ADDR, '2001:db8::1', 'ipv6addr_get', 'ipv6addr_set'),
+    (CGV_MACADDR, '00:11:22:33:44:55', 'mac_get', 'mac_set'),
+    (CGV_UUID, '5f8f6b28-8a3e-4b4a-9b1e-0d6c2c7e0a11', 'uuid_get', 'uuid_set'),
+]
+
+
+def _loop(n):
+    for _ in range(n):
+        pass
+
+
+def benchmarks(cgen):
+    """Get the benchmarks as a list of (name, function running it n times)"""
+    benches = []
+
+    def cgvar_new(n):
+        for _ in range(n):
+            CgVar(CGV_INT32, 'x', '1')
+    benches.append(('cgvar_new', cgvar_new))
+
+    for type, value, get, set in ACCESSORS:
+        cv = CgVar(type, 'x', value)
+        getter = getattr(cv, get)
+        setter = getattr(cv, set)
+        v = getter()
+
+        def get_n(n, getter=getter):
+            for _ in range(n):
+                getter()
+
+        def set_n(n, setter=setter, v=v):
+            for _ in range(n):
+                setter(v)
+        benches.append((get, get_n))
+        benches.append((set, set_n))
+
+    if _benchalloc is not None:
+        for size in (1, 8, 64):
+            capsule = _benchalloc.cvec(size)
+
+            def from_cvec(n, capsule=capsule):
+                for _ in range(n):
+                    getattr(Cvec(), '__Cvec_from_cvec')(capsule)
+            benches.append(('cvec_from_cvec_{:d}'.format(size), from_cvec))
+
+    for line in ('noargs', 'args 1 abc 10.0.0.1 true', 'expand eth0'):
+        def execute(n, line=line):
+            for _ in range(n):
+                cgen.execute(line)
+        benches.append(('callback_' + line.split()[0], execute))
+
+    for size in (16, 4096):
+        out = 'x' * size
+        buf = bytearray()
+
+        def output(n, out=out, buf=buf):
+            for _ in range(n):
+                cgen.output(buf, out)
+                del buf[:]
+        benches.append(('output_{:d}'.format(size), output))
+
+    if _benchalloc is not None:
+        for case in ('cv_new', 'cv_int32', 'cv_string', 'cvec_new'):
+            benches.append(('native_' + case,
+                            lambda n, case=case: _benchalloc.native(case, n)))
+
+    return benches
+
+
+def measure(fn, loops, repeat):
+    """Get the best ns/op of 'repeat' runs and the allocations per op"""
+    best = None
+    allocs = (0.0, 0.0)
+    fn(max(loops // 10, 1))
+    gc.disable()
+    try:
+        for _ in range(repeat):
+            a0 = _benchalloc.counts() if _benchalloc else (0, 0)
+            t0 = time.perf_counter()
+            ret = fn(loops)
+            t = time.perf_counter() - t0
+            a1 = _benchalloc.counts() if _benchalloc else (0, 0)
+            if isinstance(ret, int):
+                t = ret / 1e9    # native cases time themselves
+            ns = t * 1e9 / loops
+            if best is None or ns < best:
+                best = ns
+                allocs = ((a1[0] - a0[0]) / float(loops),
+                          (a1[1] - a0[1]) / float(loops))
+    finally:
+        gc.enable()
+    return best, allocs
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('-n', '--loops', type=int, default=100000,
+                        help='operations per run')
+    parser.add_argument('-r', '--repeat', type=int, default=5,
+                        help='runs per benchmark, the best is reported')
+    parser.add_argument('-f', '--filter', default='',
+                        help='only run benchmarks with names containing this')
+    parser.add_argument('--save', help='save the results as JSON')
+    parser.add_argument('--compare', help='compare with results saved as JSON')
+    parser.add_argument('--threshold', type=float, default=10.0,
+                        help='percent slowdown failing --compare')
+    opts = parser.parse_args()
+
+    cgen = CLIgen(SYNTAX)
+    results = {}
+    loop_ns, _ = measure(_loop, opts.loops, opts.repeat)
+    baseline = {}
+    if opts.compare:
+        with open(opts.compare) as f:
+            baseline = json.load(f)
+
+    print("{:<28s} {:>10s} {:>10s} {:>10s}{:s}".format(
+        'benchmark', 'ns/op', 'pyalloc/op', 'malloc/op',
+        '   change' if baseline else ''))
+    failed = []
+    errors = []
+    for name, fn in benchmarks(cgen):
+        if opts.filter not in name:
+            continue
+        try:
+            ns, allocs = measure(fn, opts.loops, opts.repeat)
+        except Exception as e:
+            print("{:<28s} error: {:s}".format(name, repr(e)))
+            errors.append(name)
+            continue
+        if not name.startswith('native_'):
+            ns = max(ns - loop_ns, 0.0)
+        results[name] = {'ns': ns, 'pyallocs': allocs[0], 'mallocs': allocs[1]}
+        change = ''
+        if name in baseline and baseline[name]['ns'] > 0:
+            pct = (ns - baseline[name]['ns']) * 100.0 / baseline[name]['ns']
+            change = '  {:+6.1f}%'.format(pct)
+            if pct > opts.threshold:
+                failed.append(name)
+                change += ' !'
+        if _benchalloc:
+            print("{:<28s} {:10.1f} {:10.2f} {:10.2f}{:s}".format(
+                name, ns, allocs[0], allocs[1], change))
+        else:
+            print("{:<28s} {:10.1f} {:>10s} {:>10s}{:s}".format(
+                name, ns, '-', '-', change))
+
+    if opts.save:
+        with open(opts.save, 'w') as f:
+            json.dump(results, f, indent=1, sort_keys=True)
+    if errors:
+        print("Failed: {:s}".format(', '.join(errors)))
+    if failed:
+        print("Slower than {:.0f}%: {:s}".format(opts.threshold, ', '.join(failed)))
+    return 1 if errors or failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,170 @@
+#!/usr/bin/env python
+#
+#  CLIgen grammar scaling benchmarks
+#
+# Copyright (C) 2014-2015 Benny Holmgren
+#
+#  This file is part of PyCLIgen.
+#
+#  PyPyCLIgen is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation; either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  PyCLIgen is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with PyCLIgen; see the file LICENSE.
+
+"""Benchmarks of CLIgen scaling with the size of the grammar
+
+For each grammar size a grammar is generated with gen_grammar.py and the
+following measured:
+
+    parse     Parsing the syntax into a ParseTree
+    node      Heap memory per parse tree node, from malloc statistics
+    add       CLIgen.tree_add() of the tree
+    active    CLIgen.tree_active_set(), switching between trees
+    match     Matching and running a command, as CLIgen.execute()
+    complete  Matching a partial last word, the matching done by TAB and '?'
+
+pycligen has no completion API outside the terminal, so 'complete' times the
+match of prefixes; see bench_pty.py for completion as seen by the user.
+"""
+
+import os
+import sys
+import json
+import time
+import ctypes
+import random
+import argparse
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..'))
+
+from cligen import *
+from gen_grammar import generate
+
+
+# Callback of all generated commands, looked up in __main__ by CLIgen
+def bench_cb(cgen, vr, arg):
+    return 0
+
+
+class _Mallinfo2(ctypes.Structure):
+    _fields_ = [(name, ctypes.c_size_t) for name in
+                ('arena', 'ordblks', 'smblks', 'hblks', 'hblkhd', 'usmblks',
+                 'fsmblks', 'uordblks', 'fordblks', 'keepcost')]
+
+try:
+    _mallinfo2 = ctypes.CDLL(None).mallinfo2
+    _mallinfo2.restype = _Mallinfo2
+except (AttributeError, OSError):
+    _mallinfo2 = None
+
+def heap_used():
+    """Get the bytes of heap in use, or the resident set size without glibc"""
+    if _mallinfo2 is not None:
+        mi = _mallinfo2()
+        return mi.uordblks + mi.hblkhd
+    with open('/proc/self/statm') as f:
+        return int(f.read().split()[1]) * os.sysconf('SC_PAGE_SIZE')
+
+
+def percentiles(samples):
+    samples = sorted(samples)
+    pick = lambda p: samples[min(int(p * len(samples)), len(samples) - 1)]
+    return {'mean': sum(samples) / len(samples), 'p50': pick(0.50),
+            'p99': pick(0.99)}
+
+
+def time_lines(cgen, lines):
+    """Get the time in us of executing each line, errors included"""
+    samples = []
+    for line in lines:
+        t0 = time.perf_counter()
+        try:
+            cgen.execute(line)
+        except ValueError:
+            pass
+        samples.append((time.perf_counter() - t0) * 1e6)
+    return samples
+
+
+def bench_size(size, opts):
+    g = generate(size, fanout=opts.fanout, vars=opts.vars, refs=opts.refs,
+                 refsize=opts.refsize)
+    rnd = random.Random(size)
+    cgen = CLIgen()
+    result = {'commands': g.commands}
+
+    for name in sorted(g.subtrees):
+        cgen.tree_add(name, ParseTree(cgen, syntax=g.subtrees[name]))
+
+    mem = heap_used()
+    t0 = time.perf_counter()
+    pt = ParseTree(cgen, syntax=g.syntax)
+    result['parse_ms'] = (time.perf_counter() - t0) * 1e3
+    nodes = len(pt._nodes())
+    result['nodes'] = nodes
+    result['node_bytes'] = float(heap_used() - mem) / max(nodes, 1)
+
+    t0 = time.perf_counter()
+    cgen.tree_add('main', pt)
+    result['add_us'] = (time.perf_counter() - t0) * 1e6
+
+    names = ['main'] + sorted(g.subtrees)
+    t0 = time.perf_counter()
+    for i in range(opts.samples):
+        cgen.tree_active_set(names[i % len(names)])
+    result['active_us'] = (time.perf_counter() - t0) * 1e6 / opts.samples
+    cgen.tree_active_set('main')
+
+    lines = [rnd.choice(g.lines) for _ in range(opts.samples)]
+    result['match_us'] = percentiles(time_lines(cgen, lines))
+    prefixes = [line[:-1] if len(line.split()[-1]) > 1 else line + ' '
+                for line in lines]
+    result['complete_us'] = percentiles(time_lines(cgen, prefixes))
+
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('-s', '--sizes', default='10,100,1000,10000,100000',
+                        help='comma separated numbers of commands')
+    parser.add_argument('--fanout', type=int, default=10)
+    parser.add_argument('--vars', type=float, default=0.3)
+    parser.add_argument('--refs', type=int, default=4)
+    parser.add_argument('--refsize', type=int, default=10)
+    parser.add_argument('--samples', type=int, default=2000,
+                        help='command lines timed per size')
+    parser.add_argument('--save', help='save the results as JSON')
+    opts = parser.parse_args()
+
+    print("{:>8s} {:>8s} {:>10s} {:>9s} {:>9s} {:>9s} {:>17s} {:>17s}".format(
+        'commands', 'nodes', 'parse ms', 'B/node', 'add us', 'active us',
+        'match us p50/p99', 'compl us p50/p99'))
+    results = {}
+    for size in [int(s) for s in opts.sizes.split(',')]:
+        r = bench_size(size, opts)
+        results[size] = r
+        print("{:8d} {:8d} {:10.2f} {:9.1f} {:9.2f} {:9.2f} {:>17s} {:>17s}".format(
+            r['commands'], r['nodes'], r['parse_ms'], r['node_bytes'],
+            r['add_us'], r['active_us'],
+            "{:.1f}/{:.1f}".format(r['match_us']['p50'], r['match_us']['p99']),
+            "{:.1f}/{:.1f}".format(r['complete_us']['p50'],
+                                   r['complete_us']['p99'])))
+        sys.stdout.flush()
+
+    if opts.save:
+        with open(opts.save, 'w') as f:
+            json.dump(results, f, indent=1, sort_keys=True)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,232 @@
+#!/usr/bin/env python
+#
+#  CLIgen keystroke latency benchmark
+#
+# Copyright (C) 2014-2015 Benny Holmgren
+#
+#  This file is part of PyCLIgen.
+#
+#  PyPyCLIgen is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation; either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  PyCLIgen is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with PyCLIgen; see the file LICENSE.
+
+"""Keystroke latency of CLIgen.eval() as seen on a terminal
+
+A CLI running eval() on a generated grammar is started on a pseudo-terminal,
+and commands are typed into it one key at a time. The time from writing each
+key to the terminal to reading the CLI's response is measured:
+
+    echo      A character, until it is echoed
+    tab       TAB after each word, until the completion is written
+    help      '?' after the command, until the help and line are redrawn
+    enter     Enter, until the command has run and the prompt is back
+
+Background load can be added with busy processes (--load) and with busy
+threads in the CLI process (--threads), which compete for its GIL. Needs
+nothing but a Linux pty, so it runs headless on CI.
+"""
+
+import os
+import pty
+import sys
+import json
+import time
+import fcntl
+import errno
+import select
+import struct
+import random
+import signal
+import termios
+import argparse
+import threading
+import multiprocessing
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..'))
+
+from cligen import *
+from gen_grammar import generate
+
+PROMPT = 'bench> '
+
+
+# Callback of all generated commands, looked up in __main__ by CLIgen
+def bench_cb(cgen, vr, arg):
+    return 0
+
+
+def _spin():
+    while True:
+        pass
+
+
+def cli(g, threads):
+    """Run the CLI, in the child on the pty"""
+    cgen = CLIgen()
+    cgen.tree_add('main', ParseTree(cgen, syntax=g.syntax))
+    cgen.tree_active_set('main')
+    cgen.prompt_set(PROMPT)
+    for _ in range(threads):
+        t = threading.Thread(target=_spin)
+        t.daemon = True
+        t.start()
+    cgen.eval()
+
+
+class Terminal(object):
+    'The master side of the pty, reading the CLI output'
+
+    def __init__(self, fd, timeout):
+        self.fd = fd
+        self.timeout = timeout
+        self.buf = ''
+
+    def key(self, key, done):
+        """Write key and read until done(output since key) is true
+
+        Returns:
+            The latency in us, or None on timeout
+            """
+        self.buf = ''
+        t0 = time.perf_counter()
+        os.write(self.fd, key.encode())
+        deadline = t0 + self.timeout
+        while not done(self.buf):
+            left = deadline - time.perf_counter()
+            if left <= 0:
+                return None
+            r, w, x = select.select([self.fd], [], [], left)
+            if r:
+                try:
+                    data = os.read(self.fd, 65536)
+                except OSError as e:
+                    if e.errno != errno.EIO:
+                        raise
+                    data = b''
+                if not data:
+                    raise EOFError("CLI exited: " + repr(self.buf[-200:]))
+                self.buf += data.decode('utf-8', 'replace')
+        return (time.perf_counter() - t0) * 1e6
+
+    def drain(self, quiet=0.05):
+        while select.select([self.fd], [], [], quiet)[0]:
+            if not os.read(self.fd, 65536):
+                break
+
+
+def percentiles(samples):
+    if not samples:
+        return None
+    samples = sorted(samples)
+    pick = lambda p: samples[min(int(p * len(samples)), len(samples) - 1)]
+    return {'n': len(samples), 'p50': pick(0.50), 'p90': pick(0.90),
+            'p99': pick(0.99), 'max': samples[-1]}
+
+
+def run(opts):
+    g = generate(opts.commands, fanout=opts.fanout, vars=0, refs=0)
+    rnd = random.Random(opts.seed)
+
+    pid, fd = pty.fork()
+    if pid == 0:
+        try:
+            cli(g, opts.threads)
+        finally:
+            os._exit(0)
+
+    fcntl.ioctl(fd, termios.TIOCSWINSZ, struct.pack('HHHH', 1000, 200, 0, 0))
+    term = Terminal(fd, opts.timeout)
+    load = []
+    samples = {'echo': [], 'tab': [], 'help': [], 'enter': []}
+    timeouts = dict((k, 0) for k in samples)
+
+    def record(kind, us):
+        if us is None:
+            timeouts[kind] += 1
+        else:
+            samples[kind].append(us)
+
+    try:
+        if term.key('', lambda out: out.endswith(PROMPT)) is None:
+            raise RuntimeError("no prompt from CLI: " + repr(term.buf[-200:]))
+        for _ in range(opts.load):
+            p = multiprocessing.Process(target=_spin)
+            p.daemon = True
+            p.start()
+            load.append(p)
+
+        for _ in range(opts.lines):
+            line = ''
+            for word in rnd.choice(g.lines).split():
+                for c in word:
+                    line += c
+                    record('echo', term.key(c, lambda out, c=c: c in out))
+                us = term.key('\t', lambda out: len(out) > 0)
+                record('tab', us)
+                if not term.buf.endswith(' '):
+                    term.drain()
+                    term.key(' ', lambda out: ' ' in out)
+                line += ' '
+            record('help', term.key('?', lambda out, l=line:
+                                    out.rstrip(' ').endswith(PROMPT + l.rstrip())))
+            term.drain()
+            record('enter', term.key('\r', lambda out: out.endswith(PROMPT)))
+        os.write(fd, b'\x04')
+    finally:
+        for p in load:
+            p.terminate()
+        try:
+            os.kill(pid, signal.SIGTERM)
+        except OSError:
+            pass
+        os.waitpid(pid, 0)
+        os.close(fd)
+
+    return dict((k, {'us': percentiles(samples[k]), 'timeouts': timeouts[k]})
+                for k in samples)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('-n', '--commands', type=int, default=1000,
+                        help='commands in the grammar')
+    parser.add_argument('--fanout', type=int, default=10)
+    parser.add_argument('-l', '--lines', type=int, default=100,
+                        help='command lines to type')
+    parser.add_argument('--load', type=int, default=0,
+                        help='busy processes running while typing')
+    parser.add_argument('--threads', type=int, default=0,
+                        help='busy threads in the CLI process')
+    parser.add_argument('--timeout', type=float, default=2.0,
+                        help='seconds to wait for a response to a key')
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--save', help='save the results as JSON')
+    opts = parser.parse_args()
+
+    results = run(opts)
+    print("{:<6s} {:>6s} {:>9s} {:>9s} {:>9s} {:>9s} {:>8s}".format(
+        'key', 'n', 'p50 us', 'p90 us', 'p99 us', 'max us', 'timeouts'))
+    for kind in ('echo', 'tab', 'help', 'enter'):
+        r = results[kind]
+        us = r['us'] or {'n': 0, 'p50': 0, 'p90': 0, 'p99': 0, 'max': 0}
+        print("{:<6s} {:6d} {:9.1f} {:9.1f} {:9.1f} {:9.1f} {:8d}".format(
+            kind, us['n'], us['p50'], us['p90'], us['p99'], us['max'],
+            r['timeouts']))
+
+    if opts.save:
+        with open(opts.save, 'w') as f:
+            json.dump(results, f, indent=1, sort_keys=True)
+    return 1 if any(results[k]['timeouts'] for k in results) else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
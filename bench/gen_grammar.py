@@ -0,0 +1,170 @@
+#!/usr/bin/env python
+#
+#  CLIgen grammar generator
+#
+# Copyright (C) 2014-2015 Benny Holmgren
+#
+#  This file is part of PyCLIgen.
+#
+#  PyPyCLIgen is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation; either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  PyCLIgen is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with PyCLIgen; see the file LICENSE.
+
+"""Generate synthetic CLIgen grammars of a given size and shape
+
+Commands are paths of keywords through a tree with the given fan-out, so
+commands share prefixes as in vendor grammars. A share of them end in a
+variable, or in a reference to one of a number of subtrees. For example:
+
+    ./gen_grammar.py -n 100000 --fanout 8 --vars 0.3 --refs 4 > big.cli
+
+writes the subtrees first, each starting with a treename statement, then the
+main tree.
+"""
+
+import sys
+import random
+import argparse
+
+# Variable types and a value of each, for command lines matching them
+VAR_VALUES = {
+    'string': 'abc',
+    'int32': '42',
+    'uint16': '7',
+    'bool': 'true',
+    'ipv4addr': '10.0.0.1',
+    'ipv6addr': '2001:db8::1',
+    'macaddr': '00:11:22:33:44:55',
+}
+
+
+class Grammar(object):
+    'A generated grammar'
+
+    def __init__(self):
+        self.syntax = ''        # Main tree syntax
+        self.subtrees = {}      # Subtree name to syntax
+        self.lines = []         # A matching command line for each command
+        self.commands = 0       # Number of commands, including in subtrees
+
+    def cli(self):
+        """Get the grammar as a single .cli file"""
+        out = []
+        for name in sorted(self.subtrees):
+            out.append('treename="{:s}";\n'.format(name))
+            out.append(self.subtrees[name])
+        out.append('treename="main";\n')
+        out.append(self.syntax)
+        return ''.join(out)
+
+
+def generate(commands, fanout=10, depth=0, vars=0.3,
+             types=('string', 'int32', 'ipv4addr'), refs=0, refratio=0.1,
+             refsize=10, help=True, callback='bench_cb', seed=1):
+    """Generate a grammar
+
+    Args:
+        'commands':  Number of commands in the main tree
+        'fanout':    Keywords per tree node
+        'depth':     Minimum number of keywords per command
+        'vars':      Share of commands ending in a variable
+        'types':     Variable types to pick from, see VAR_VALUES
+        'refs':      Number of subtrees
+        'refratio':  Share of commands ending in a subtree reference
+        'refsize':   Number of commands in each subtree
+        'help':      If True keywords have help texts
+        'callback':  Callback of all commands
+        'seed':      Random seed, the same seed gives the same grammar
+
+    Returns:
+        A Grammar object
+        """
+    rnd = random.Random(seed)
+    fanout = max(fanout, 2)
+    levels = max(depth, 1)
+    while fanout ** levels < commands:
+        levels += 1
+
+    def keyword(name):
+        if help:
+            return '{:s}("Help for {:s}")'.format(name, name)
+        return name
+
+    def variable(n):
+        type = types[n % len(types)]
+        return '<v{:d}:{:s}>'.format(n % len(types), type), VAR_VALUES[type]
+
+    g = Grammar()
+    for r in range(refs):
+        syntax = []
+        for c in range(refsize):
+            syntax.append('{:s}, {:s}();\n'.format(keyword('r{:d}c{:d}'.format(r, c)),
+                                                    callback))
+        g.subtrees['sub{:d}'.format(r)] = ''.join(syntax)
+        g.commands += refsize
+
+    syntax = []
+    for i in range(commands):
+        words = []
+        n = i
+        for level in range(levels):
+            words.append('k{:d}_{:d}'.format(level, n % fanout))
+            n //= fanout
+        tokens = [keyword(w) for w in words]
+        line = list(words)
+        p = rnd.random()
+        if not refs:
+            p += refratio
+        if p < refratio:
+            r = rnd.randrange(refs)
+            syntax.append('{:s} @sub{:d};\n'.format(' '.join(tokens), r))
+            line.append('r{:d}c{:d}'.format(r, rnd.randrange(refsize)))
+        else:
+            if p < refratio + vars:
+                var, value = variable(i)
+                tokens.append(var)
+                line.append(value)
+            syntax.append('{:s}, {:s}();\n'.format(' '.join(tokens), callback))
+        g.lines.append(' '.join(line))
+    g.syntax = ''.join(syntax)
+    g.commands += commands
+
+    return g
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('-n', '--commands', type=int, default=1000)
+    parser.add_argument('--fanout', type=int, default=10)
+    parser.add_argument('--depth', type=int, default=0)
+    parser.add_argument('--vars', type=float, default=0.3)
+    parser.add_argument('--types', default='string,int32,ipv4addr')
+    parser.add_argument('--refs', type=int, default=0)
+    parser.add_argument('--refratio', type=float, default=0.1)
+    parser.add_argument('--refsize', type=int, default=10)
+    parser.add_argument('--nohelp', action='store_true')
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--lines', help='also write matching command lines here')
+    opts = parser.parse_args()
+
+    g = generate(opts.commands, opts.fanout, opts.depth, opts.vars,
+                 tuple(opts.types.split(',')), opts.refs, opts.refratio,
+                 opts.refsize, not opts.nohelp, seed=opts.seed)
+    sys.stdout.write(g.cli())
+    if opts.lines:
+        with open(opts.lines, 'w') as f:
+            f.write('\n'.join(g.lines) + '\n')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
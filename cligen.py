@@ -30,9 +30,23 @@ from __future__ import unicode_literals, absolute_import, print_function
 __version__ = '0.1'
 
 
+import io
+import os
+import re
 import sys
-import copy
+import json
+import pstats
+import cProfile
+import signal
+import weakref
+import struct
+import inspect
 import ipaddress
+import threading
+import traceback
+import collections
+import multiprocessing
+import multiprocessing.connection
 if sys.version_info.major < 3:
     from urlparse import urlparse
 else:
@@ -100,6 +114,7 @@ class CLIgen (_cligen.CLIgen):
 
         # Call parent to setup CLIgen structures.
         super(CLIgen, self).__init__(*args, **kwargs)
+        self._offload = None
 
         if numargs is 1:
             if len(kwargs) > 0: # named argument
@@ -124,29 +139,272 @@ class CLIgen (_cligen.CLIgen):
         """
 CLIgen output function. All terminal output should be made via this method
 
+Output is buffered by the CLIgen instance and written when a command has
+completed, when the buffer fills up or when output_flush() is called.
+
    Args:
-      file:  The IO object to direct the output to, such as a file or sys.stdout
-      out:   The output string/object
+      file:  The object to direct the output to. Either a file or file-like
+             object such as sys.stdout, io.StringIO or io.BytesIO, or a
+             bytearray which the output is appended to.
+      out:   The output string/object. bytes, bytearray and memoryview
+             objects are written as is, other objects are converted to str.
 
    Returns:
       None
 
    Raises:
       IOError:  If there is a problem writing to the file object
+      TypeError: If 'file' is not a valid output target
 
       """    
-        return super(CLIgen, self)._output(file, str(out))
+        if not isinstance(out, (bytes, bytearray, memoryview)):
+            out = str(out)
+        return super(CLIgen, self)._output(file, out)
+
 
 
 
+    def execute(self, line, capture=True):
+        """
+Execute a command line in the active ParseTree without reading from the
+terminal, as done by eval() for each line entered.
+
+   Args:
+      line:     The command line to execute
+      capture:  If True, all output made by the command via output() is
+                captured and returned instead of being written to its target
+
+   Returns:
+      A tuple (status, output) where 'status' is the value returned by the
+      callback and 'output' the captured output as a string, or None if
+      'capture' is False.
+
+   Raises:
+      ValueError:   If the command line does not match a command, or
+                    matches more than one
+      RuntimeError: If CLIgen fails to parse the command line
+      """
+        return super(CLIgen, self)._execute(line, 1 if capture else 0)
+
+
+    def profile(self, line, capture=True):
+        """
+Execute a command line like execute(), with its callback run under cProfile.
+Profiling starts before the callback arguments are converted, so the
+binding's own overhead is included, and is not enabled for other commands.
 
+   Args:
+      line:     The command line to execute
+      capture:  If True, all output made by the command via output() is
+                captured and returned instead of being written to its target
+
+   Returns:
+      A tuple (status, output, profile) as returned by execute(), with
+      'profile' a CommandProfile of the callback
+
+   Raises:
+      ValueError:   If the command line does not match a command, or
+                    matches more than one
+      RuntimeError: If CLIgen fails to parse the command line
+      """
+        prof = cProfile.Profile()
+        status, output = super(CLIgen, self)._execute(line,
+                                                      1 if capture else 0,
+                                                      prof)
+        return (status, output, CommandProfile(prof))
+
+
+    def profile_prefix(self, prefix='profile'):
+        """
+Let lines entered in eval() be profiled by starting them with a prefix word,
+as in 'profile show interfaces'. The command is run with profile() and its
+pstats report written after its output.
+
+   Args:
+      prefix:  The prefix word, or None to disable
+      """
+        super(CLIgen, self).profile_prefix_set(prefix)
+
+
+    def _profile_line(self, line):
+        try:
+            status, output, prof = self.profile(line.strip(), capture=False)
+        except (ValueError, RuntimeError) as e:
+            print(str(e))
+            return -1
+        self.output(sys.stdout, prof.stats())
+        return status
+
+
+    def stats(self):
+        """
+Get the command latency statistics. They are always collected, per callback
+and per phase of the command, and cleared by stats_reset(). The phases are:
+
+   'match'     Matching the command line in CLIgen
+   'convert'   Building the Cvec and argument passed to the callback
+   'callback'  Running the callback, including writing its output
+
+The match time of lines that did not run a callback is kept under None.
+
+   Returns:
+      A dict mapping callback names to a dict of the phases, each a dict with
+      'count', 'total', 'min' and 'max' latency in ns and a list 'buckets'
+      where bucket i counts latencies from 2**i up to 2**(i+1) ns.
+      """
+        return super(CLIgen, self)._stats()
+
+
+    def trace_dump(self, file=None):
+        """
+Dump the events recorded since trace_start() in Chrome trace JSON format,
+as loaded by chrome://tracing or Perfetto. Begin and end events are recorded
+for each command line, command callback, expand callback and output flush.
+Line events are named "line", or after the command line itself if tracing was
+started with trace_start(size, True). Timestamps are CLOCK_MONOTONIC, as used by perf, in microseconds.
+
+   Args:
+      file:  An optional file name or file object to write the trace to
+
+   Returns:
+      The trace as a JSON string if 'file' is None, else None
+
+   Raises:
+      IOError:  If there is a problem writing to the file
+      """
+        pid = os.getpid()
+        events = [{'name': name, 'cat': cat, 'ph': ph, 'ts': ts / 1000.0,
+                   'pid': pid, 'tid': tid}
+                  for ts, ph, cat, tid, name in self._trace_events()]
+        trace = json.dumps({'traceEvents': events, 'displayTimeUnit': 'ns'})
+        if file is None:
+            return trace
+        if isinstance(file, str):
+            with open(file, 'w') as f:
+                f.write(trace)
+        else:
+            file.write(trace)
+
+
+    def offload_start(self, workers=None):
+        """
+Fork the pool of worker processes running the callbacks decorated with
+offload(). Otherwise the pool is started by the first offloaded command.
+Since the workers are forked, callbacks defined after the pool has started
+are not known to them.
+
+   Args:
+      workers:  The number of worker processes. Defaults to the number of CPUs.
+
+   Returns:
+      None
+
+   Raises:
+      RuntimeError: If the pool is already running
+      """
+        if self._offload is not None:
+            raise RuntimeError("offload pool already running")
+        self._offload = _OffloadPool(self, workers or os.cpu_count() or 1)
+        self._regfd(self._offload.wakeup)
+
+
+    def offload_stop(self):
+        """
+Stop the pool of worker processes. Running jobs are terminated and queued
+jobs dropped.
+
+   Returns:
+      None
+      """
+        if self._offload is not None:
+            self._unregfd(self._offload.wakeup)
+            self._offload.stop()
+            self._offload = None
+
+
+    def offload_output(self):
+        """
+Write the output and notifications of background jobs received so far, and
+replace workers that exited. eval() does so as jobs report back while it
+waits at the prompt, and before each prompt. Applications not using eval()
+call this instead.
+
+   Returns:
+      None
+      """
+        if self._offload is not None:
+            self._offload.respawn()
+            self._offload.drain()
+
+
+    def _cligen_prompt(self):
+        self.offload_output()
+
+
+    def _cligen_fd(self, fd):
+        # A background job reported back while eval() waits at the prompt.
+        # Write its output over the line being edited and redraw the line.
+        if self._offload is None or fd != self._offload.wakeup:
+            return
+        self._offload.respawn()
+        if self._offload.drain(erase=True):
+            self._offload.write(self.prompt() + self._buf())
+
+
+    def jobs(self):
+        """
+Get the background jobs of offloaded callbacks.
+
+   Returns:
+      A list of tuples (job, name, state) where 'job' is the job number,
+      'name' the callback name and 'state' either 'queued' or 'running'.
+      """
+        if self._offload is None:
+            return []
+        return self._offload.jobs()
+
+
+    def job_cancel(self, job):
+        """
+Cancel a background job. A running job has its worker process terminated
+and replaced.
+
+   Args:
+      job:  The job number
+
+   Returns:
+      True if the job was cancelled, False if there is no such job
+      """
+        if self._offload is None:
+            return False
+        return self._offload.cancel(job)
+
+
+    #
+    # A callback returns its status as an int. It may instead return an
+    # iterator, typically by being a generator, yielding chunks of output.
+    # The chunks are pulled as the pager advances and written to sys.stdout,
+    # and the iterator is closed early if the user quits the pager.
+    #
+    # Callbacks decorated with kwargs_callback() get the variables as keyword
+    # arguments instead of a Cvec, see kwargs_callback(). Callbacks decorated
+    # with offload() run as background jobs in worker processes, see
+    # offload().
+    #
     def _cligen_cb(self, name, vr, arg):
 #        module_name, class_name = name.rsplit(".", 1)
 #        m = importlib.import_module(module_name)
 
-        if hasattr(sys.modules['__main__'], name) is True:
-            return getattr(sys.modules['__main__'], name)(self, vr, arg)
-        return None
+        fn = getattr(sys.modules['__main__'], name, None)
+        if fn is None:
+            return None
+        if getattr(fn, '_cligen_offload', False):
+            if self._offload is None:
+                self.offload_start()
+            job = self._offload.submit(name, vr, arg)
+            self.output(sys.stdout, "[{:d}] {:s}\n".format(job, name))
+            return 0
+        return _cligen_call(self, fn, vr, arg)
 
     def _cligen_expand(self, name, vr, arg):
 
@@ -188,188 +446,15 @@ class CgVar (_cligen.CgVar):
     def __str__(self):
         return super(CgVar, self).__str__()
 
-    def __int__(self):
-        return int(self._getnumber())
-
-    def __float__(self):
-        return float(self._getnumber())
-
     def __cmp__(self, other):
         return super(CgVar, self).__cmp__(other)
 
-    def __hash__(self):
-        return hash(str(self))
-    
-    def __eq__(self, other):
-        return self.__cmp__(other) == 0
-
-    def __ne__(self, other):
-        return self.__cmp__(other) != 0
-
-    def __lt__(self, other):
-        return self.__cmp__(other) < 0
-
-    def __gt__(self, other):
-        return self.__cmp__(other) > 0
+    #
+    # Arithmetic (+, -, *, /), in-place arithmetic (+=, -=, *=, /=), int(),
+    # float(), comparisons and hashing are implemented by _cligen.CgVar.
+    # In-place arithmetic updates the value of the variable itself.
+    #
 
-    def __le__(self, other):
-        return self.__cmp__(other) <= 0
-
-    def __ge__(self, other):
-        return self.__cmp__(other) >= 0
-
-    def __add__(self, other):
-
-        val = None
-        stype = self.type_get()
-        if isinstance(other, CgVar):
-            otype = other.type_get()
-        else:
-            otype = stype;
-
-        if self.isnumeric():
-            if isinstance(other, CgVar):
-                if other.isnumeric():
-                    val = self._getnumber() + other._getnumber()
-                elif other.isstring():
-                    val = str(self) + str(other)
-            elif isinstance(other, int):
-                val = self._getnumber() + other
-            elif isinstance(other, str):
-                val = str(self) + other
-
-        elif self.isstring():
-            val = str(self) + str(other)
-
-        if val is None:
-            raise TypeError("unsupported operand type(s) for +: 'CgVar({:s})' and CgVar({:s})".format(self.type2str(), other.type2str()))
-        
-        if (stype < otype):
-            type = otype
-        else:
-            type = stype;
-        return CgVar(type, self.name_get(), val)
-
-
-    def __iadd__(self, other):
-        result = self.__add__(other)
-        self.parse(str(result))
-        return self
-
-    def __sub__(self, other):
-
-        val = None
-        stype = self.type_get()
-        if isinstance(other, CgVar):
-            otype = other.type_get()
-        else:
-            otype = stype;
-
-        if self.isnumeric():
-            if isinstance(other, CgVar):
-                if other.isnumeric():
-                    val = self._getnumber() - other._getnumber()
-                elif other.isstring():
-                    val = str(self) - str(other)
-            elif isinstance(other, int):
-                val = self._getnumber() - other
-            elif isinstance(other, str):
-                val = str(self) - other
-
-        elif self.isstring():
-            val = str(self) - str(other)
-
-        if val is None:
-            raise TypeError("unsupported operand type(s) for -: 'CgVar({:s})' and CgVar({:s})".format(self.type2str(), other.type2str()))
-        
-        if (stype < otype):
-            type = otype
-        else:
-            type = stype;
-        return CgVar(type, self.name_get(), val)
-
-
-    def __isub__(self, other):
-        result = self.__sub__(other)
-        self.parse(str(result))
-        return self
-
-    def __mul__(self, other):
-        stype = self.type_get()
-        if isinstance(other, CgVar):
-            otype = other.type_get()
-        else:
-            otype = stype;
-
-        if self.isnumeric():
-            factor1 = self._getnumber()
-        else:
-            raise TypeError("unsupported operand type for *: 'CgVar({:s})'".format(self.type2str()))
-        
-        if isinstance(other, CgVar):
-            if other.isnumeric():
-                factor2 = other._getnumber()
-            else:
-                raise TypeError("unsupported operand type for *: 'CgVar({:s})'".format(other.type2str()))
-            
-        elif isinstance(other, int) or isinstance(other, float):
-            factor2 = other
-            
-        else:
-            raise TypeError("unsupported operand type for *: '{:s}'".format(other.__class__.__name__))
-        
-        val = factor1 * factor2
-        if (stype < otype):
-            type = otype
-        else:
-            type = stype;
-        return CgVar(type, self.name_get(), val)
-        
-        
-    def __imul__(self, other):
-        result = self.__mul__(other)
-        self.parse(str(result))
-        return self
-        
-    def __truediv__(self, other):
-        precision = self._dec64_n_get()
-        stype = self.type_get()
-        if isinstance(other, CgVar):
-            otype = other.type_get()
-        else:
-            otype = stype;
-
-        if self.isnumeric():
-            factor1 = self._getnumber()
-        else:
-            raise TypeError("unsupported operand type for /: 'CgVar({:s})'".format(self.type2str()))
-        
-        if isinstance(other, CgVar):
-            if other.isnumeric():
-                factor2 = other._getnumber()
-            else:
-                raise TypeError("unsupported operand type for /: 'CgVar({:s})'".format(other.type2str()))
-            
-        elif isinstance(other, int) or isinstance(other, float):
-            factor2 = other
-            
-        else:
-            raise TypeError("unsupported operand type for /: '{:s}'".format(other.__class__.__name__))
-        
-        val = factor1 / factor2
-        if (stype < otype):
-            type = otype
-        else:
-            type = stype;
-        fmt = '{:.'+str(precision)+'f}'
-        return CgVar(type, self.name_get(), fmt.format(val))
-        
-        
-    def __itruediv__(self, other):
-        result = self.__div__(other)
-        self.parse(str(result))
-        return self
-        
     def __div__(self, other):
         return self.__truediv__(other)
 
@@ -379,49 +464,11 @@ class CgVar (_cligen.CgVar):
     def __copy__(self):
         return super(CgVar, self).__copy__()
 
-    def _getnumber(self):
-        if self.isnumeric() is False:
-            raise ValueError("not a number object")
-        type = self.type_get()
-        if type is CGV_INT8:
-            return self.int8_get()
-        elif type is CGV_INT16:
-            return self.int16_get()
-        elif type is CGV_INT32:
-            return self.int32_get()
-        elif type is CGV_INT64:
-            return self.int64_get()
-        elif type is CGV_UINT8:
-            return self.uint8_get()
-        elif type is CGV_UINT16:
-            return self.uint16_get()
-        elif type is CGV_UINT32:
-            return self.uint32_get()
-        elif type is CGV_UINT64:
-            return self.uint64_get()
-        elif type is CGV_DEC64:
-            return self.dec64_get()
- 
-    def _setnumber(self, num):
-        if self.isnumeric() is False:
-            raise ValueError("not a number object")
-        type = self.type_get()
-        if type is CGV_INT:
-            return self.int_set(num)
-        elif type is CGV_LONG:
-            return self.long_set(num)
-
-    def isnumeric(self):
-        if self.type_get() in [CGV_INT8, CGV_INT16, CGV_INT32, CGV_INT64, CGV_UINT8, CGV_UINT16, CGV_UINT32, CGV_UINT64, CGV_DEC64]:
-            return True
-        return False
-
-    def isstring(self):
-        if self.type_get() in [CGV_STRING, CGV_REST, CGV_INTERFACE, CGV_URL]:
-            return True
-        return False
-    
-
+    #
+    # The 'value' property, mapping the variable to and from the natural
+    # Python object for its type, and isnumeric()/isstring() are implemented
+    # by _cligen.CgVar.
+    #
 
     def name_get(self):
         """Get CgVar variable name
@@ -847,7 +894,8 @@ class CgVar (_cligen.CgVar):
    Raises:
       ValueError: If 'self' is not a decimal value
       """
-        return super(CgVar, self)._uint64_set(str(value))
+        return super(CgVar, self)._dec64_set(str(value),
+                                             self._dec64_n_get())
 
     def bool_get(self):
         """Get CgVar variable boolean value
@@ -926,7 +974,7 @@ class CgVar (_cligen.CgVar):
       TypeError:  If the CgVar object is not of the types CGV_IPV4ADDR
                   of CGV_IPV4PFX.
    """
-        return ipaddress.IPv4Address(super(CgVar, self)._ipv4addr_get())
+        return super(CgVar, self)._ipv4addr_get()
 
 
  
@@ -946,44 +994,47 @@ class CgVar (_cligen.CgVar):
         return super(CgVar, self)._ipv4masklen_get()
 
 
-#    def ipv4addr_set(self, addr):
-#        """Get IPv4 address value from CgVar object.
-#
-#    Args:
-#        addr: An ipaddress.IPv4Address object
-#
-#    Returns:
-#        True if successful
-#
-#    Raises:
-#        TypeError:  If the CgVar object is not of the type CGV_IPV4ADDR
-#        MemoryError: If needed memory was not available
-#
-#    """
-#        if self.type_get() is not CGV_IPV4ADDR:
-#            raise TypeError("invalid type")    
-#        return self.parse(str(addr))
+    def ipv4addr_set(self, addr):
+        """Set IPv4 address value of CgVar object.
 
+   Args:
+      addr: An ipaddress.IPv4Address object, the packed address as 'bytes'
+            or the address as an 'int'
 
+   Returns:
+      The new value as an ipaddress.IPv4Address object
 
-#    def ipv4prefix_set(self, pfx):
-#        """Get IPv4 address value from CgVar object.
-#
-#    Args:
-#        pfx: An ipaddress.IPv4Network object
-#
-#    Returns:
-#        True if successful
-#
-#    Raises:
-#        TypeError:  If the CgVar object is not of the types CGV_IPV4PFX.
-#        MemoryError: If needed memory was not available
-#
-#    """
-#        if self.type_get() is not CGV_IPV4PFX:
-#            raise TypeError("invalid type")    
-#        return self.parse(str(pfx))
+   Raises:
+      TypeError:  If the CgVar object is not of the types CGV_IPV4ADDR
+                  of CGV_IPV4PFX.
+      ValueError: If addr is not a valid address
+    """
+        return super(CgVar, self)._ipv4addr_set(addr)
+
+
+
+    def ipv4prefix_set(self, pfx):
+        """Set IPv4 prefix value of CgVar object.
+
+   Args:
+      pfx: An ipaddress.IPv4Interface or ipaddress.IPv4Network object
+
+   Returns:
+      The new value as an ipaddress.IPv4Interface object
 
+   Raises:
+      TypeError:  If the CgVar object is not of the type CGV_IPV4PFX.
+      ValueError: If pfx is not a valid prefix
+    """
+        if self.type_get() is not CGV_IPV4PFX:
+            raise TypeError("invalid type")    
+        if isinstance(pfx, ipaddress.IPv4Network):
+            addr, masklen = pfx.network_address, pfx.prefixlen
+        else:
+            addr, masklen = pfx.ip, pfx.network.prefixlen
+        super(CgVar, self)._ipv4addr_set(addr)
+        super(CgVar, self)._ipv4masklen_set(masklen)
+        return self.value
 
 
     def ipv6addr_get(self):
@@ -999,7 +1050,7 @@ class CgVar (_cligen.CgVar):
       TypeError:  If the CgVar object is not of the types CGV_IPV6ADDR
                   of CGV_IPV6PFX.
     """
-        return ipaddress.IPv6Address(super(CgVar, self)._ipv6addr_get())
+        return super(CgVar, self)._ipv6addr_get()
 
 
     def ipv6masklen_get(self):
@@ -1019,43 +1070,47 @@ class CgVar (_cligen.CgVar):
 
 
 
-#    def ipv6addr_set(self, addr):
-#        """Get IPv6 address value from CgVar object.
-#
-#    Args:
-#        addr: An ipaddress.IPv6Address object
-#
-#    Returns:
-#        True if successful
-#
-#    Raises:
-#        TypeError:  If the CgVar object is not of the type CGV_IPV6ADDR
-#        MemoryError: If needed memory was not available
-#
-#    """
-#        if self.type_get() is not CGV_IPV6ADDR:
-#            raise TypeError("invalid type")    
-#        return self.parse(str(addr))
+    def ipv6addr_set(self, addr):
+        """Set IPv6 address value of CgVar object.
 
+   Args:
+      addr: An ipaddress.IPv6Address object, the packed address as 'bytes'
+            or the address as an 'int'
 
+   Returns:
+      The new value as an ipaddress.IPv6Address object
+
+   Raises:
+      TypeError:  If the CgVar object is not of the types CGV_IPV6ADDR
+                  of CGV_IPV6PFX.
+      ValueError: If addr is not a valid address
+    """
+        return super(CgVar, self)._ipv6addr_set(addr)
 
-#    def ipv6prefix_set(self, pfx):
-#        """Get IPv6 address value from CgVar object.
-#
-#    Args:
-#        pfx: An ipaddress.IPv6Network object
-#
-#    Returns:
-#        True if successful
-#
-#    Raises:
-#        TypeError:  If the CgVar object is not of the types CGV_IPV6PFX.
-#        MemoryError: If needed memory was not available
-#
-#    """
-#        if self.type_get() is not CGV_IPV6PFX:
-#            raise TypeError("invalid type")    
-#        return self.parse(str(pfx))
+
+
+    def ipv6prefix_set(self, pfx):
+        """Set IPv6 prefix value of CgVar object.
+
+   Args:
+      pfx: An ipaddress.IPv6Interface or ipaddress.IPv6Network object
+
+   Returns:
+      The new value as an ipaddress.IPv6Interface object
+
+   Raises:
+      TypeError:  If the CgVar object is not of the type CGV_IPV6PFX.
+      ValueError: If pfx is not a valid prefix
+    """
+        if self.type_get() is not CGV_IPV6PFX:
+            raise TypeError("invalid type")    
+        if isinstance(pfx, ipaddress.IPv6Network):
+            addr, masklen = pfx.network_address, pfx.prefixlen
+        else:
+            addr, masklen = pfx.ip, pfx.network.prefixlen
+        super(CgVar, self)._ipv6addr_set(addr)
+        super(CgVar, self)._ipv6masklen_set(masklen)
+        return self.value
 
 
     def mac_get(self):
@@ -1074,6 +1129,23 @@ class CgVar (_cligen.CgVar):
 
 
 
+    def mac_set(self, mac):
+        """Set CgVar variable MAC address value
+
+   Args:
+      mac: The MAC address value as an 'int'
+
+   Returns:
+     The new MAC address value as an 'int'
+    
+   Raises:
+      TypeError:  If the CgVar object is not of the type CGV_MACADDR
+      ValueError: If mac is out of range
+      """
+        return super(CgVar, self)._mac_set(mac)
+
+
+
     def uuid_get(self):
         """Get CgVar variable UUID value
 
@@ -1090,6 +1162,22 @@ class CgVar (_cligen.CgVar):
 
 
 
+    def uuid_set(self, uuid):
+        """Set CgVar variable UUID value
+
+   Args:
+      uuid: An 'uuid.UUID' object or the UUID as 16 'bytes'
+
+   Returns:
+     The new UUID as an 'uuid' object
+    
+   Raises:
+      TypeError:  If the CgVar object is not of the type CGV_UUID
+      ValueError: If uuid is not a valid UUID
+      """
+        return super(CgVar, self)._uuid_set(uuid)
+
+
 
     def time_get(self):
         """Get time value of CgVar object.
@@ -1127,7 +1215,7 @@ class CgVar (_cligen.CgVar):
             raise TypeError("'self' is of invalid type")
 
         if isinstance(timespec, int) or isinstance(timespec, float):
-            super(CgVar, self)._time_set(str(float(timespec)))
+            super(CgVar, self)._time_set(float(timespec))
         elif isinstance(timespec, str):
             self.parse(timespec)
             
@@ -1193,203 +1281,737 @@ to 'self'.  The parsing is based on the current type set.
 #
 # Cvec
 #
+# A Cvec whose variables all are of the same numeric or address type supports
+# the buffer protocol, see _cligen.Cvec. memoryview(cvec) gives its values
+# packed as by parse_bulk().
+#
+# Cvec.encode() and CgVar.encode() give a compact binary encoding of the
+# variables, names and types included, that decode() turns back into a Cvec
+# or CgVar. Pickling uses the same encoding.
+#
 class Cvec (_cligen.Cvec):
     'A vector of CgVar'
 
-    def __init__(self, arg=None):
-        self._cvec = []
-        if arg is not None:
-            if (isinstance(arg, list)):
-                for cv in arg:
-                    self.append(cv)
-            else:
-                raise ValueError
+    #
+    # Construction, indexing by position or name, iteration, len(), 'in',
+    # + and +=, copying, append(), index(), keys(), as_dict(), encode() and
+    # pickling are implemented by _cligen.Cvec.
+    # Lookups by name use an index of the variable names.
+    # Copies and concatenations share their CgVar objects with the original
+    # Cvecs until either side changes or hands out a variable.
+    #
 
-        
-    def __str__(self):
+    def remove(self, val):
+        del self[self.index(val)]
 
-        return self._cvec.__str__()
 
-#        str = "["
-#        for cv in self._cvec:
-#            str += "$%s=%s" % (cv.name_get(), cv)
-#        str += "]"
-#
-#        return str
 
-    def __repr__(self):
-        return self._cvec.__repr__()
 
-    def __getitem__(self, key):
 
-        if isinstance(key, int):
-            return self._cvec[key]
+#
+# ParseTree
+#
+class ParseTree (_cligen.ParseTree):
+    'CLIgen parse tree'
 
-        elif isinstance(key, str):
-            for cv in self._cvec:
-                if cv.name_get() == key:
-                    return cv
-            raise IndexError("element not found")
+    #
+    # Matches of the tree's commands are counted, see coverage().
+    #
 
+    def __init__(self, *args, **kwargs):
+        """
+   Args:
+      CLIgen:  The CLIgen instance
+      syntax:  A string containing a CLIgen syntax specification
+       or
+      file:    The name of a file containing a CLIgen syntax specification
+
+   Raises:
+      TypeError:    If invalid arguments are provided.
+      IOError:      If the file cannot be read
+      ValueError:   If the syntax cannot be parsed successfully
+      """
+        super(ParseTree, self).__init__(*args, **kwargs)
+        cgen = kwargs['CLIgen'] if 'CLIgen' in kwargs else args[0]
+        self._cligen = weakref.ref(cgen)
+        if 'file' in kwargs or len(args) > 2:
+            self._file = kwargs['file'] if 'file' in kwargs else args[2]
+            self._syntax = None
         else:
-            raise TypeError('key must be int or str')
-    
+            self._file = '__syntax__'
+            self._syntax = kwargs.get('syntax', args[1] if len(args) > 1 else '')
 
-    def __setitem__(self, key, cv):
-        if isinstance(key, int):
-            pass
-        elif isinstance(key, str):
-            for idx, c in enumerate(self._cvec):
-                if c.name_get() == key:
-                    key = idx
+
+    def _lines(self):
+        if self._syntax is not None:
+            return self._syntax.splitlines()
+        try:
+            with open(self._file) as f:
+                return f.read().splitlines()
+        except (IOError, OSError):
+            return []
+
+
+    def coverage(self):
+        """
+Get the number of matches of each node in the tree, counted since the tree
+was created or coverage_reset() was called. A node's count includes the
+matches of all commands below it.
+
+A tree reference @name is followed by the nodes of the tree it references,
+with the commands reached through it. Their matches are counted in this
+tree, the one the command line was matched in.
+
+Each node is mapped back to the syntax by searching, from the line of its
+parent on, for the first line holding its keyword or variable name. This
+finds the line that defines the node for usual syntax files, where each
+token is written once per branch.
+
+   Returns:
+      A list with a dict for each node, in syntax order, with keys:
+        'command'   The tokens of the command up to and including the node
+        'callback'  The name of the callback of the node or None
+        'hits'      The number of matches
+        'file'      The syntax file name, or '__syntax__' for a string
+        'line'      The line number in the syntax, or None if not found
+      """
+        hits = {}
+        for key, n in self._hits().items():
+            for i in range(1, len(key) + 1):
+                hits[key[:i]] = hits.get(key[:i], 0) + n
+        return self._coverage(hits, [], set())[0]
+
+
+    def _coverage(self, hits, prefix, trees):
+        # Nodes of this tree placed below prefix, and their total of matches
+        cgen = self._cligen()
+        lines = self._lines()
+        path = list(prefix)
+        starts = []
+        nodes = []
+        total = 0
+        for depth, token, callback in self._nodes():
+            del path[len(prefix) + depth:]
+            del starts[depth:]
+            path.append(token)
+            if token.startswith('<'):
+                pattern = r'<\s*' + re.escape(token[1:].split(':')[0]) + r'\b'
+            else:
+                pattern = r'(?<![\w@-])' + re.escape(token) + r'(?![\w-])'
+            begin = starts[-1] if starts else 0
+            line = None
+            for i in range(begin, len(lines)):
+                if not lines[i].lstrip().startswith('#') and \
+                        re.search(pattern, lines[i]):
+                    line = i
                     break
-            if isinstance(key, str):  # not found
-                raise IndexError("element not found")
+            starts.append(line if line is not None else begin)
+            node = {'command': ' '.join(path),
+                    'callback': callback,
+                    'hits': hits.get(tuple(path), 0),
+                    'file': self._file,
+                    'line': line + 1 if line is not None else None}
+            nodes.append(node)
+
+            # The referenced commands replace the reference in the match
+            name = token[1:] if token.startswith('@') else None
+            tree = cgen.tree(name) if name and cgen is not None else None
+            if isinstance(tree, ParseTree) and name not in trees:
+                below, node['hits'] = tree._coverage(hits, path[:-1],
+                                                     trees | {name})
+                nodes += below
+            if depth == 0:
+                total += node['hits']
+        return nodes, total
+
+
+    def coverage_report(self, hot=10):
+        """
+Format a coverage report of the commands of the tree, that is the nodes with
+a callback: those never matched, followed by the most matched ones.
 
-        else:
-            raise TypeError('key must be int or str')
+   Args:
+      hot:  The number of most matched commands to list
 
-        if (isinstance(cv, CgVar)):
-            self._cvec[key] = cv;
-        elif isinstance(cv, str):
-            self._cvec[key].parse(cv)
-        else:
-            raise TypeError('cv must be CgVar or str')
+   Returns:
+      The report as a string, one 'file:line: hits command' line per command
+      """
+        commands = [n for n in self.coverage() if n['callback'] is not None]
+        unused = [n for n in commands if n['hits'] == 0]
+        used = sorted((n for n in commands if n['hits'] > 0),
+                      key=lambda n: n['hits'], reverse=True)
 
-        return self._cvec[key]
+        def fmt(n):
+            return "{:s}:{:s}: {:d} {:s}".format(
+                n['file'], str(n['line']) if n['line'] else '?',
+                n['hits'], n['command'])
 
+        report = ["Unused commands ({:d} of {:d}):".format(len(unused),
+                                                           len(commands))]
+        report += ["  " + fmt(n) for n in unused]
+        report += ["Hot commands:"]
+        report += ["  " + fmt(n) for n in used[:hot]]
+        return "\n".join(report) + "\n"
 
-    def __iter__(self):
-        for cv in self._cvec:
-            yield cv
 
-    def __len__(self):
-        return len(self._cvec)
-    
-    def __contains__(self, key):
-        for cv in self._cvec:
-            if cv.name_get() == key:
-                return True
-        return False
 
-    def __add__(self, other):
-        if isinstance(other, Cvec):
-            new._cvec += other._cvec
-            return new
 
-        elif isinstance(other, CgVar):
-            new = copy.copy(self)
-            new.append(other)
-            return new
-        else:
-            raise TypeError("unsupported operand type for +: '{:s}'".format(other.__class__.__name__))
-        
+def type2str(type):
+    """Get string representation of a CLIgen type
 
-    def __iadd__(self, other):
-        if isinstance(other, Cvec):
-            self._cvec += other._cvec
-        elif isinstance(other, CgVar):
-            self.append(other)
-        else:
-            raise TypeError("unsupported operand type for +: '{:s}'".format(other.__class__.__name__))
-        
-        return self
+    Args:
+        'type': The CLIgen type
+
+    Returns:
+        MemoryError: If needed memory was not available
+        """
+    return CgVar().type2str(type)
 
 
-    def __copy__(self):
-        new = self.__class__()
-        for cv in self._cvec: 
-            new.append(copy.copy(cv))
-        return new
 
-    def __deepcopy__(self, memo):
-        return self.__copy__()
-    
-                
-    def index(self, val):
-        for idx, cv in enumerate(self._cvec):
-            if isinstance(val, str):
-                if cv.name_get() == val:
-                    return idx
-            elif isinstance(val, CgVar):
-                if cv == val:
-                    return idx
-            else:
-                raise ValueError
+def parse_bulk(type, strings):
+    """Parse a sequence of strings as values of one CLIgen type
 
-    def remove(self, val):
-        del self[self.index(val)]
+    Numeric and address types are parsed without holding the interpreter
+    lock and returned packed in an 'array.array':
 
+      CGV_INT8 .. CGV_UINT64     'b', 'h', 'i', 'q', 'B', 'H', 'I', 'Q'
+      CGV_DEC64, CGV_TIME        'd'
+      CGV_BOOL                   'B'
+      CGV_MACADDR                'Q'
+      CGV_IPV4ADDR, CGV_IPV4PFX  'I', the address in host byte order
+      CGV_IPV6ADDR, CGV_IPV6PFX,
+      CGV_UUID                   'B', 16 bytes per value in network byte order
 
-    def append(self, arg):
-        if isinstance(arg, int):
-            cv = CgVar(arg)
-        elif isinstance(arg, CgVar):
-            cv = arg
-        else:
-            raise TypeError("argument must be int or CgVar")
+    For prefix types the values are a tuple of the address array and an
+    array.array('B') of mask lengths. Other types are returned as a list of
+    CgVar objects.
+
+    Args:
+        'type':    The CLIgen type
+        'strings': A sequence of strings to parse
+
+    Returns:
+        A tuple (values, errors) where 'errors' is a 'bytearray' with a
+        non-zero byte for each string that could not be parsed. The
+        corresponding value is 0 or None.
+
+    Raises:
+        TypeError:   If 'strings' is not a sequence
+        MemoryError: If needed memory was not available
+        """
+    return _cligen._parse_bulk(type, strings)
+
+
+
+def decode(buf):
+    """Decode a Cvec or CgVar encoded by Cvec.encode() or CgVar.encode()
+
+    The variables are created directly from 'buf', which may be any object
+    supporting the buffer protocol, such as a memoryview of shared memory.
+
+    Args:
+        'buf': The encoded Cvec or CgVar
+
+    Returns:
+        A new Cvec or CgVar object
+
+    Raises:
+        ValueError:  If 'buf' is not a valid encoding
+        MemoryError: If needed memory was not available
+        """
+    return _cligen._decode(buf)
+
+
+
+def memory():
+    """Get the native memory in use by the binding
+
+    Memory allocated by libcligen and the binding's own C buffers is not seen
+    by Python. It is counted per kind here, and also reported to tracemalloc
+    under the domain MEMORY_DOMAIN, traced to where it was allocated from
+    Python. To see it with tracemalloc:
+
+        snapshot = tracemalloc.take_snapshot().filter_traces(
+            [tracemalloc.DomainFilter(True, cligen.MEMORY_DOMAIN)])
+
+    The sizes of cg_vars ('cgvar') and parse trees ('parsetree'), which are
+    allocated inside libcligen, are estimates.
+
+    Returns:
+        A dict mapping each kind to a dict with 'count' and 'bytes' in use
+        """
+    return _cligen._memory()
 
-        self._cvec.append(cv)
-        return cv;
 
-    def keys(self):
-        keys = []
-        for cv in self._cvec:
-            if cv.name_get() != None:
-                keys.append(cv.name_get()) 
-        return keys                        
 
+_metrics_fields = ('lines', 'commands', 'errors', 'nomatch', 'ambiguous',
+                   'callback_ns', 'expands', 'expand_ns', 'output_bytes')
+
+def metrics_read(file):
+    """Read a metrics file published with CLIgen.metrics_open()
+
+    The file may be read while the process updates it, or after it exits.
+    See pycligen_metrics.h for the layout, for readers in other languages.
+
+    Args:
+        'file': The metrics file name
+
+    Returns:
+        A dict with 'version', 'pid', 'start_ns' and the counters
+
+    Raises:
+        ValueError:  If the file is not a metrics file
+        IOError:     If the file cannot be read
+        """
+    with open(file, 'rb') as f:
+        buf = f.read(4096)
+    if len(buf) < 32 or buf[:8] != b'CGMETRIC':
+        raise ValueError("not a metrics file: {:s}".format(file))
+    version, size, pid, start = struct.unpack_from('=IIQQ', buf, 8)
+    count = min((size - 32) // 8, len(_metrics_fields))
+    metrics = {'version': version, 'pid': pid, 'start_ns': start}
+    metrics.update(zip(_metrics_fields,
+                       struct.unpack_from('={:d}Q'.format(count), buf, 32)))
+    return metrics
+
+
+
+def _cligen_call(cligen, fn, vr, arg):
+    params = getattr(fn, '_cligen_kwargs', None)
+    if params is None:
+        return fn(cligen, vr, arg)
+
+    names, wants_arg = params
+    kwargs = vr.as_dict(names)
+    if wants_arg:
+        kwargs['arg'] = arg
+    return fn(cligen, **kwargs)
+
+
+
+def kwargs_callback(fn):
+    """Decorator making a callback receive the variables as keyword arguments
+
+    The callback is called as fn(cligen, **variables) instead of
+    fn(cligen, vr, arg), with the value (see CgVar.value) of each variable
+    named as one of its parameters. Variables not matching a parameter are
+    left out unless the callback takes **kwargs. A variable missing from the
+    command gets the parameter default. A parameter named 'arg' is passed the
+    callback argument rather than a variable.
+
+    The signature is inspected once, when the callback is decorated.
+
+    Example:
+        @cligen.kwargs_callback
+        def set_vlan(cligen, id, name='default'):
+            ...
+
+    Args:
+        'fn': The callback function
+
+    Returns:
+        The callback function
+        """
+    params = list(inspect.signature(fn).parameters.values())[1:]
+    if any(p.kind == p.VAR_KEYWORD for p in params):
+        names = None
+    else:
+        names = frozenset(p.name for p in params 
+                          if p.kind in (p.POSITIONAL_OR_KEYWORD, p.KEYWORD_ONLY))
+    wants_arg = any(p.name == 'arg' and p.kind != p.VAR_KEYWORD for p in params)
+    fn._cligen_kwargs = (names, wants_arg)
+    return fn
+
+
+def offload(fn):
+    """Decorator making a callback run as a background job in a worker process
+
+    The Cvec and argument are sent to a worker process of the pool started
+    by CLIgen.offload_start(), using their binary encoding (see Cvec.encode()).
+    The command returns at once so the prompt stays responsive. Output the
+    callback makes with cligen.output(), or yields, is sent back and written
+    to sys.stdout, without paging, as it arrives while CLIgen.eval() waits
+    at the prompt, which is then redrawn, or when CLIgen.offload_output()
+    is called. The callback gets a stand-in
+    for the CLIgen object, whose other methods act on the worker's copy.
+
+    Running jobs are listed by CLIgen.jobs() and cancelled by
+    CLIgen.job_cancel(). May be combined with kwargs_callback().
+
+    Example:
+        @cligen.offload
+        def show_routes(cligen, vr, arg):
+            ...
+
+    Args:
+        'fn': The callback function
+
+    Returns:
+        The callback function
+        """
+    fn._cligen_offload = True
+    return fn
 
 
 
 #
-# ParseTree
+# Offload pool
 #
-#class ParseTree():
-#    'CLIgen parse tree'
+# Each worker process is forked with one end of a pipe, over which it gets
+# (job, name, vr, arg) tuples, or None to exit, and sends back
+# ('output', job, data) for each chunk of output and finally ('done', job,
+# status) or ('error', job, traceback). A reader thread in the CLI process
+# queues the output and hands queued jobs to idle workers. It wakes the main
+# thread through a pipe, which CLIgen.eval() watches at the prompt, to write
+# the output and fork replacements for workers that exited, so the pool only
+# forks from the main thread.
 #
+class _OffloadJob(object):
+
+    def __init__(self, job, name, vr, arg):
+        self.job = job
+        self.name = name
+        self.vr = vr
+        self.arg = arg
+        self.state = 'queued'
+
+
+class _OffloadWorker(object):
+
+    def __init__(self, proc, conn):
+        self.proc = proc
+        self.conn = conn
+        self.job = None
+
+
+class _OffloadOutput(object):
+    'The CLIgen object as seen by an offloaded callback'
+
+    def __init__(self, cligen, conn):
+        self._cligen = cligen
+        self._conn = conn
+        self._job = None
+
+    def output(self, file, out):
+        if isinstance(out, (bytearray, memoryview)):
+            out = bytes(out)
+        elif not isinstance(out, bytes):
+            out = str(out)
+        self._conn.send(('output', self._job, out))
+
+    def output_flush(self):
+        pass
+
+    def __getattr__(self, name):
+        return getattr(self._cligen, name)
+
+
+def _offload_worker(cligen, conn):
+    signal.signal(signal.SIGINT, signal.SIG_IGN)
+    proxy = _OffloadOutput(cligen, conn)
+    while True:
+        try:
+            msg = conn.recv()
+        except EOFError:
+            break
+        if msg is None:
+            break
+        proxy._job, name, vr, arg = msg
+        try:
+            fn = getattr(sys.modules['__main__'], name)
+            ret = _cligen_call(proxy, fn, vr, arg)
+            if hasattr(ret, '__next__'):
+                for chunk in ret:
+                    proxy.output(None, chunk)
+                ret = 0
+            conn.send(('done', proxy._job, ret if isinstance(ret, int) else 0))
+        except Exception:
+            conn.send(('error', proxy._job, traceback.format_exc()))
+
+
+class _OffloadPool(object):
+
+    def __init__(self, cligen, workers):
+        self._cligen = cligen
+        self._ctx = multiprocessing.get_context('fork')
+        self._lock = threading.Lock()
+        self._jobs = {}
+        self._queue = collections.deque()
+        self._pending = collections.deque()
+        self._exited = []
+        self._fd = os.dup(sys.stdout.fileno())
+        self.wakeup, self._wakeup_w = os.pipe()
+        os.set_blocking(self.wakeup, False)
+        os.set_blocking(self._wakeup_w, False)
+        self._next = 1
+        self._running = True
+        self._workers = [self._spawn() for i in range(workers)]
+        self._thread = threading.Thread(target=self._reader,
+                                        name='cligen-offload')
+        self._thread.daemon = True
+        self._thread.start()
+
+    def _spawn(self):
+        conn, child = self._ctx.Pipe()
+        proc = self._ctx.Process(target=_offload_worker,
+                                 args=(self._cligen, child))
+        proc.daemon = True
+        proc.start()
+        child.close()
+        return _OffloadWorker(proc, conn)
+
+    # Job output is queued by the reader thread and written by the main
+    # thread with drain(), so it never shares the CLIgen output channel with
+    # the reader nor lands in the middle of the line being edited.
+    def _output(self, out):
+        self._pending.append(out)
+        self._wakeup()
+
+    def _wakeup(self):
+        try:
+            os.write(self._wakeup_w, b'\0')
+        except (BlockingIOError, InterruptedError):
+            pass
+
+    def write(self, out):
+        if not isinstance(out, bytes):
+            out = out.encode('utf-8', 'replace')
+        while out:
+            try:
+                out = out[os.write(self._fd, out):]
+            except InterruptedError:
+                continue
+            except OSError:
+                break
+
+    # Returns True if there was output. With erase, the line at the prompt
+    # is cleared first.
+    def drain(self, erase=False):
+        try:
+            while os.read(self.wakeup, 512):
+                pass
+        except (BlockingIOError, InterruptedError):
+            pass
+        if not self._pending:
+            return False
+        if erase:
+            self.write('\r\x1b[K')
+        while self._pending:
+            self.write(self._pending.popleft())
+        return True
+
+    # Fork replacements for workers that exited. Only called from the main
+    # thread, the reader thread leaves them in _exited.
+    def respawn(self):
+        while True:
+            with self._lock:
+                if not self._exited or not self._running:
+                    return
+                w = self._exited.pop()
+            w.proc.join()
+            new = self._spawn()
+            with self._lock:
+                self._workers.append(new)
+                self._dispatch()
+
+    # Called with the lock held
+    def _dispatch(self):
+        for w in self._workers:
+            if not self._queue:
+                break
+            if w.job is None:
+                w.job = self._queue.popleft()
+                w.job.state = 'running'
+                w.conn.send((w.job.job, w.job.name, w.job.vr, w.job.arg))
+                w.job.vr = w.job.arg = None
+
+    def _reader(self):
+        while self._running:
+            with self._lock:
+                conns = dict((w.conn, w) for w in self._workers)
+            for conn in multiprocessing.connection.wait(list(conns), 0.2):
+                w = conns[conn]
+                try:
+                    msg = conn.recv()
+                except (EOFError, OSError):
+                    msg = None
+                if msg is None:     # Worker died or was cancelled
+                    self._exit(w)
+                    continue
+                kind, job, data = msg
+                if kind == 'output':
+                    if job in self._jobs:
+                        self._output(data)
+                    continue
+                with self._lock:
+                    j = self._jobs.pop(job, None)
+                    w.job = None
+                    self._dispatch()
+                if j is None:
+                    continue
+                if kind == 'error':
+                    self._output(data)
+                    data = -1
+                self._output("[{:d}] Done({:d}) {:s}\n".format(job, data, j.name))
+
+    def _exit(self, w):
+        with self._lock:
+            j = w.job
+            if j is not None:
+                self._jobs.pop(j.job, None)
+            w.conn.close()
+            self._workers.remove(w)
+            self._exited.append(w)
+        if j is not None:
+            self._output("[{:d}] {:s} {:s}\n".format(j.job,
+                "Cancelled" if j.state == 'cancelled' else "Terminated", j.name))
+        else:
+            self._wakeup()
+
+    def submit(self, name, vr, arg):
+        self.respawn()
+        with self._lock:
+            j = _OffloadJob(self._next, name, vr, arg)
+            self._next += 1
+            self._jobs[j.job] = j
+            self._queue.append(j)
+            self._dispatch()
+        return j.job
+
+    def jobs(self):
+        with self._lock:
+            return [(j.job, j.name, j.state) for j in 
+                    sorted(self._jobs.values(), key=lambda j: j.job)]
+
+    def cancel(self, job):
+        with self._lock:
+            j = self._jobs.get(job)
+            if j is None or j.state == 'cancelled':
+                return False
+            if j.state == 'queued':
+                self._queue.remove(j)
+                del self._jobs[job]
+                return True
+            j.state = 'cancelled'
+            for w in self._workers:
+                if w.job is j:
+                    w.proc.terminate()
+        return True
+
+    def stop(self):
+        self._running = False
+        self._thread.join()
+        with self._lock:
+            for w in self._workers:
+                if w.job is None:
+                    w.conn.send(None)
+                else:
+                    w.proc.terminate()
+            for w in self._workers:
+                w.proc.join()
+                w.conn.close()
+            for w in self._exited:
+                w.proc.join()
+            self._workers = []
+            self._exited = []
+            self._jobs.clear()
+            self._queue.clear()
+        self.drain()
+        os.close(self._fd)
+        os.close(self.wakeup)
+        os.close(self._wakeup_w)
+
+
 
-#        """ParseTree constructor. 
-#        
-#Takes one named argument:
-#  string='<syntax format>' - String will be parsed as CLIgen syntax.
-#  file='<filename>'        - Argument specifies a file containing CLIgen syntax.
-#If argument is unnamed, itinplies a "string" argument.
-#"""
-##        super(ParseTree, self).__init__(*args, **kwargs)
-#        if len(kwargs) == 1:
-#            if "file" in kwargs:
-#                with open(kwargs['file'], 'r') as f:
-#                    self.syntax = f.read()
-#            elif "string" in kwargs:
-#                self.syntax = kwargs['string']
-#            else:
-#                raise AttributeError("Argument named 'string' or 'file' expected")
-#            
-#        elif len(args) == 1:
-#            self.syntax = args[0]
-#
-#        else:
-#            raise TypeError("__init__() takes 1 positional argument")
-#
-#        if isinstance(self.syntax, str) is False:
-#                raise AttributeError("Argument must be string")
 #
+# CommandProfile
 #
+class CommandProfile(object):
+    'The cProfile profile of a command, as returned by CLIgen.profile()'
 
+    def __init__(self, prof):
+        self.profile = prof
 
 
+    def stats(self, sort='cumulative', limit=30):
+        """
+Format the profile as a pstats report.
 
-def type2str(type):
-    """Get string representation of a CLIgen type
+   Args:
+      sort:   The pstats sort key
+      limit:  The maximum number of functions listed, or None for all
 
-    Args:
-        'type': The CLIgen type
+   Returns:
+      The report as a string
+      """
+        out = io.StringIO()
+        st = pstats.Stats(self.profile, stream=out)
+        st.sort_stats(sort)
+        if limit is None:
+            st.print_stats()
+        else:
+            st.print_stats(limit)
+        return out.getvalue()
 
-    Returns:
-        MemoryError: If needed memory was not available
+
+    def collapsed(self, depth=64):
         """
-    return CgVar().type2str(type)
+Format the profile as collapsed stacks, one 'caller;...;callee usecs' line
+per call path, as read by flamegraph.pl and speedscope. cProfile only records
+caller to callee edges, so the time of a function called from several paths
+is split between them in proportion to the time of each edge.
+
+The number of paths grows exponentially with the call graph, so paths are
+cut at a depth, with the time below added to the last function, and paths
+with less than a microsecond, which would not be listed, are not followed.
+
+   Args:
+      depth:  The maximum number of functions in a path
+
+   Returns:
+      The collapsed stacks as a string
+      """
+        st = pstats.Stats(self.profile).stats
+        callees = collections.defaultdict(dict)
+        for func, (cc, nc, tt, ct, callers) in st.items():
+            for caller, edge in callers.items():
+                callees[caller][func] = edge
+        stacks = collections.defaultdict(float)
+
+        def name(func):
+            return "{:s} ({:s}:{:d})".format(func[2], os.path.basename(func[0]),
+                                             func[1]).replace(';', ',')
+
+        def walk(func, path, ct):
+            total = st[func][3]
+            scale = ct / total if total else 0.0
+            path = path + [name(func)]
+            if len(path) >= depth:
+                stacks[';'.join(path)] += ct
+                return
+            stacks[';'.join(path)] += st[func][2] * scale
+            for callee, edge in callees[func].items():
+                if edge[3] * scale >= 1e-6 and name(callee) not in path:
+                    walk(callee, path, edge[3] * scale)
+
+        for func, (cc, nc, tt, ct, callers) in st.items():
+            if not callers:
+                walk(func, [], ct)
+
+        return "".join("{:s} {:d}\n".format(k, int(v * 1e6))
+                       for k, v in sorted(stacks.items()) if int(v * 1e6) > 0)
+
+
+    def dump(self, file):
+        """
+Save the profile in the marshal format read by pstats and snakeviz.
+
+   Args:
+      file:  The file name
+      """
+        self.profile.dump_stats(file)
+
 
 
 # Testing..
@@ -20,6 +20,7 @@
  * <http://www.gnu.org/licenses/>.
  */
 
+#define PY_SSIZE_T_CLEAN
 #include <Python.h>
 
 #include <cligen/cligen.h>
@@ -28,6 +29,12 @@
 #include "pycligen_cv.h"
 #include "pycligen_pt.h"
 #include "pycligen_cvec.h"
+#include "pycligen_output.h"
+#include "pycligen_stats.h"
+#include "pycligen_trace.h"
+#include "pycligen_probes.h"
+#include "pycligen_metrics.h"
+#include "pycligen_mem.h"
 
 #define CLIgen_MAGIC  0x8abe91a1
 
@@ -37,6 +44,15 @@ typedef struct {
     int                      ch_magic;    /* magic (HDR)*/
     struct _CLIgen	    *ch_self;
     cligen_handle            ch_cligen;   /* cligen handle */
+    OutputChannel           *ch_output;   /* output channel */
+    Stats                   *ch_stats;    /* command latency statistics */
+    uint64_t                 ch_match_ns; /* match time of current line */
+    int                      ch_match_pending; /* ch_match_ns not recorded */
+    Trace                   *ch_trace;    /* event tracer, NULL if none */
+    PyObject                *ch_profile;  /* profiler of callbacks, or NULL */
+    char                    *ch_profile_prefix; /* eval() profile prefix */
+    Metrics                 *ch_metrics;  /* metrics page, NULL if none */
+    int                      ch_metrics_fd; /* locked metrics file */
 } *CLIgen_handle;
 
 
@@ -162,17 +178,103 @@ CLIgen_handle_init(void)
 
     memset(h, 0, sizeof(*h));
     h->ch_magic = CLIgen_MAGIC;
+    if ((h->ch_output = OutputChannel_new()) == NULL) {
+	free(h);
+	return NULL;
+    }
+    if ((h->ch_stats = Stats_new()) == NULL) {
+	OutputChannel_free(h->ch_output);
+	free(h);
+	return NULL;
+    }
 
     return h;
 }
 
 static void CLIgen_handle_exit(CLIgen_handle h)
 {
+    OutputChannel_free(h->ch_output);
+    Stats_free(h->ch_stats);
+    Trace_free(h->ch_trace);
+    free(h->ch_profile_prefix);
+    Metrics_close(h->ch_metrics, h->ch_metrics_fd);
     free(h);
 }
 
+/*
+ * Flush the output channel
+ */
 static int
-CLIgen_callback(cligen_handle h, cvec *vars, cg_var *arg)
+CLIgen_flush(CLIgen_handle ch)
+{
+    int ret;
+
+    TRACE(ch->ch_trace, TRACE_FLUSH, 'B', "flush");
+    ret = OutputChannel_flush(ch->ch_output);
+    TRACE(ch->ch_trace, TRACE_FLUSH, 'E', "flush");
+    METRICS_SET(ch->ch_metrics, mp_output_bytes, OutputChannel_bytes(ch->ch_output));
+
+    return ret;
+}
+
+/*
+ * Pull output chunks from an iterator returned by a callback and write them
+ * to sys.stdout as the pager advances. If the user quits the pager the
+ * iterator is closed, so a generator stops producing output.
+ */
+static int
+CLIgen_stream(CLIgen_handle ch, PyObject *iterator)
+{
+    int ret = 0;
+    PyObject *Stdout;
+    PyObject *item;
+    PyObject *Chunk;
+    PyObject *Ret;
+    PyObject *Type, *Value, *Tb;
+
+    if ((Stdout = PySys_GetObject("stdout")) == NULL) {
+	PyErr_SetString(PyExc_RuntimeError, "lost sys.stdout");
+	return -1;
+    }
+    Py_INCREF(Stdout);
+
+    OutputChannel_pager_start(ch->ch_output, cligen_terminalrows(ch->ch_cligen));
+    while (ret == 0 && (item = PyIter_Next(iterator))) {
+	if (PyUnicode_Check(item) || PyObject_CheckBuffer(item))
+	    Chunk = item;
+	else {
+	    Chunk = PyObject_Str(item);
+	    Py_DECREF(item);
+	    if (Chunk == NULL) {
+		ret = -1;
+		break;
+	    }
+	}
+	ret = OutputChannel_output(ch->ch_output, Stdout, Chunk, OUTPUT_PAGE_STREAM);
+	Py_DECREF(Chunk);
+    }
+    Py_DECREF(Stdout);
+    if (PyErr_Occurred())
+	ret = -1;
+
+    /* Quit from pager or error, let the generator clean up */
+    if (ret != 0 && PyObject_HasAttrString(iterator, "close")) {
+	PyErr_Fetch(&Type, &Value, &Tb);
+	Ret = PyObject_CallMethod(iterator, "close", NULL);
+	if (Ret == NULL) {
+	    if (Type == NULL)
+		return -1;
+	    PyErr_Clear();	/* Keep the original error */
+	}
+	Py_XDECREF(Ret);
+	PyErr_Restore(Type, Value, Tb);
+    }
+
+    return ret == 1 ? 0 : ret;
+}
+
+static int
+_CLIgen_callback(cligen_handle h, cvec *vars, cg_var *arg)
 {
     char *func;
     CLIgen_handle ch = (CLIgen_handle)h;
@@ -182,8 +284,15 @@ CLIgen_callback(cligen_handle h, cvec *vars, cg_var *arg)
     PyObject *Cvec = NULL;
     PyObject *Capsule = NULL;
     int retval = -1;
+    int match = ch->ch_match_pending;
+    uint64_t t0;
+    uint64_t t1;
+    uint64_t t2;
+    StatsEntry *se;
     PyObject *Arg = NULL;
     
+    ch->ch_match_pending = 0;
+    t0 = Stats_now();
     
     if ((Cvec = PyObject_CallMethod(__cligen_module(), "Cvec",  NULL)) == NULL)
 	return -1; 
@@ -210,12 +319,29 @@ CLIgen_callback(cligen_handle h, cvec *vars, cg_var *arg)
     
     /* Run callback */
     func = cligen_fn_str_get(ch->ch_cligen);
+    t1 = Stats_now();
     Value =  PyObject_CallMethod(self, "_cligen_cb", "sOO", func, Cvec, Arg);
+    if (Value && PyIter_Check(Value))
+	retval = CLIgen_stream(ch, Value);
+    else if (Value)
+	retval = PyLong_AsLong(Value);
     if (PyErr_Occurred())
 	PyErr_Print();
-    if (Value) {
-	retval = PyLong_AsLong(Value);
+    if (CLIgen_flush(ch) < 0)
+	perror("CLIgen output");
+
+    t2 = Stats_now();
+    if ((se = Stats_entry(ch->ch_stats, func)) != NULL) {
+	if (match)
+	    Stats_record(se, STATS_MATCH, ch->ch_match_ns);
+	Stats_record(se, STATS_CONVERT, t1 - t0);
+	Stats_record(se, STATS_CALLBACK, t2 - t1);
     }
+    METRICS_ADD(ch->ch_metrics, mp_commands, 1);
+    METRICS_ADD(ch->ch_metrics, mp_callback_ns, t2 - t0);
+    if (retval < 0)
+	METRICS_ADD(ch->ch_metrics, mp_errors, 1);
+
     Py_DECREF(Arg);
     Py_DECREF(Cvec);
     Py_XDECREF(Value);
@@ -223,14 +349,68 @@ CLIgen_callback(cligen_handle h, cvec *vars, cg_var *arg)
     return retval;
 }
 
+/*
+ * Run the callback under the profiler set by _execute(), if any. It is
+ * enabled before the Cvec is built so the conversion is in the profile, and
+ * cleared while running so commands executed by the callback are not.
+ */
+static int
+CLIgen_profile(CLIgen_handle ch, cvec *vars, cg_var *arg)
+{
+    int retval;
+    PyObject *Prof = ch->ch_profile;
+    PyObject *Ret;
+
+    if (Prof == NULL)
+	return _CLIgen_callback((cligen_handle)ch, vars, arg);
+
+    ch->ch_profile = NULL;
+    if ((Ret = PyObject_CallMethod(Prof, "enable", NULL)) == NULL)
+	PyErr_Print();
+    Py_XDECREF(Ret);
+    retval = _CLIgen_callback((cligen_handle)ch, vars, arg);
+    if ((Ret = PyObject_CallMethod(Prof, "disable", NULL)) == NULL)
+	PyErr_Print();
+    Py_XDECREF(Ret);
+    ch->ch_profile = Prof;
+
+    return retval;
+}
+
+/*
+ * CLIgen_eval() reads lines without holding the GIL so other Python threads,
+ * such as the offload pool reader, keep running at the prompt. Callbacks
+ * take it back.
+ */
+static int
+CLIgen_callback(cligen_handle h, cvec *vars, cg_var *arg)
+{
+    int retval;
+    char *func = cligen_fn_str_get(h);
+    uint64_t t0;
+    CLIgen_handle ch = (CLIgen_handle)h;
+    PyGILState_STATE gstate;
+
+    PROBE_CALLBACK_ENTRY(func);
+    t0 = PROBE_NOW();
+    gstate = PyGILState_Ensure();
+    TRACE(ch->ch_trace, TRACE_CALLBACK, 'B', func);
+    retval = CLIgen_profile(ch, vars, arg);
+    TRACE(ch->ch_trace, TRACE_CALLBACK, 'E', func);
+    PyGILState_Release(gstate);
+    PROBE_CALLBACK_RETURN(func, retval, PROBE_NOW() - t0);
+
+    return retval;
+}
+
 cg_fnstype_t *
 CLIgen_str2fn(char *name, void *arg, char **error)
 {
     return CLIgen_callback;
 }
 
-int
-CLIgen_expand_cb(cligen_handle *h, char *func, cvec *vars, cg_var *arg, 
+static int
+_CLIgen_expand_cb(cligen_handle *h, char *func, cvec *vars, cg_var *arg, 
 	      int  *nr,
 	      char ***commands,     /* vector of function strings */
 	      char ***helptexts)   /* vector of help-texts */
@@ -340,6 +520,36 @@ done:
     return retval;
 }
 
+int
+CLIgen_expand_cb(cligen_handle *h, char *func, cvec *vars, cg_var *arg, 
+	      int  *nr,
+	      char ***commands,
+	      char ***helptexts)
+{
+    int retval;
+    uint64_t t0;
+    uint64_t m0 = 0;
+    CLIgen_handle ch = (CLIgen_handle)h;
+    PyGILState_STATE gstate;
+
+    PROBE_EXPAND_ENTRY(func);
+    t0 = PROBE_NOW();
+    gstate = PyGILState_Ensure();
+    TRACE(ch->ch_trace, TRACE_EXPAND, 'B', func);
+    if (ch->ch_metrics)
+	m0 = Stats_now();
+    retval = _CLIgen_expand_cb(h, func, vars, arg, nr, commands, helptexts);
+    if (ch->ch_metrics) {
+	METRICS_ADD(ch->ch_metrics, mp_expands, 1);
+	METRICS_ADD(ch->ch_metrics, mp_expand_ns, Stats_now() - m0);
+    }
+    TRACE(ch->ch_trace, TRACE_EXPAND, 'E', func);
+    PyGILState_Release(gstate);
+    PROBE_EXPAND_RETURN(func, retval, PROBE_NOW() - t0);
+
+    return retval;
+}
+
 expand_cb *
 CLIgen_expand_str2fn(char *name, void *arg, char **error)
 {
@@ -396,6 +606,62 @@ CLIgen_prompt(CLIgen *self)
 }
 
 
+/*
+ * The line being edited, to redraw it after writing at the prompt
+ */
+static PyObject *
+_CLIgen_buf(CLIgen *self)
+{
+    char *buf = cligen_buf(self->handle->ch_cligen);
+
+    return StringFromString(buf ? buf : "");
+}
+
+/*
+ * Called by libcligen when a file registered with _regfd() is readable
+ * while it waits for input at the prompt, without the GIL held.
+ */
+static int
+CLIgen_fd_cb(int fd, void *arg)
+{
+    PyObject *self = (PyObject *)arg;
+    PyObject *Ret;
+    PyGILState_STATE gstate;
+
+    gstate = PyGILState_Ensure();
+    if ((Ret = PyObject_CallMethod(self, "_cligen_fd", "i", fd)) == NULL)
+	PyErr_Print();
+    Py_XDECREF(Ret);
+    PyGILState_Release(gstate);
+
+    return 0;
+}
+
+static PyObject *
+_CLIgen_regfd(CLIgen *self, PyObject *args)
+{
+    int fd;
+
+    if (!PyArg_ParseTuple(args, "i", &fd))
+        return NULL;
+    if (cligen_regfd(fd, CLIgen_fd_cb, self) < 0)
+	return PyErr_NoMemory();
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+_CLIgen_unregfd(CLIgen *self, PyObject *args)
+{
+    int fd;
+
+    if (!PyArg_ParseTuple(args, "i", &fd))
+        return NULL;
+    cligen_unregfd(fd);
+
+    Py_RETURN_NONE;
+}
+
 static PyObject *
 CLIgen_prompt_set(CLIgen *self, PyObject *args)
 {
@@ -545,30 +811,38 @@ CLIgen_ignorecase_set(CLIgen *self, PyObject *args)
 static PyObject *
 _CLIgen_output(CLIgen *self, PyObject *args)
 {
-    int fd;
-    FILE *f;
-    char *output;
+    int page = 1;
     PyObject *file;
-    PyObject *fileno;
+    PyObject *out;
     
-    if (!PyArg_ParseTuple(args, "Os", &file, &output))
+    if (!PyArg_ParseTuple(args, "OO|i", &file, &out, &page))
         return NULL;
     
-    if ((fileno = PyObject_CallMethod(file, "fileno", NULL)) == NULL)
+    if (OutputChannel_output(self->handle->ch_output, file, out,
+			     (page && cligen_terminalrows(self->handle->ch_cligen)) ?
+			     OUTPUT_PAGE : OUTPUT_NOPAGE) < 0)
 	return NULL;
-    fd = PyLong_AsLong(fileno);
-    Py_DECREF(fileno);
 
-    if ((f = fdopen(fd, "a")) == NULL) {	
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+CLIgen_output_flush(CLIgen *self)
+{
+    if (CLIgen_flush(self->handle) < 0) {
 	PyErr_Format(PyExc_IOError, "%s", strerror(errno));
 	return NULL;
     }
-    
-    cligen_output(f, output);
 
     Py_RETURN_NONE;
 }
 
+static PyObject *
+CLIgen_output_bytes(CLIgen *self)
+{
+    return PyLong_FromUnsignedLongLong(OutputChannel_bytes(self->handle->ch_output));
+}
+
 
 static PyObject *
 CLIgen_exiting(CLIgen *self)
@@ -587,33 +861,36 @@ CLIgen_exiting_set(CLIgen *self, PyObject *args)
     return PyLong_FromLong(cligen_exiting_set(self->handle->ch_cligen, e));
 }
 
+/*
+ * Find ParseTree by name in list of added trees. Returns borrowed reference.
+ */
 static PyObject *
-CLIgen_tree(CLIgen *self, PyObject *args)
+CLIgen_tree_find(CLIgen *self, const char *name)
 {
-    char *name;
-    PyObject *Pt = NULL;
-    PyObject *iterator;
+    Py_ssize_t i;
     PyObject *item;
     char *n;
-    
-
-    if (!PyArg_ParseTuple(args, "s", &name))
-        return NULL;
 
-
-    if ((iterator = PyObject_GetIter(self->ptlist)) == NULL) {
-	PyErr_SetString(PyExc_ValueError, "get_iter");
-	return NULL;
-    }
-    while (Pt == NULL && (item = PyIter_Next(iterator))) {
+    for (i = 0; i < PyList_GET_SIZE(self->ptlist); i++) {
+	item = PyList_GET_ITEM(self->ptlist, i);
 	n = ParseTree_name(item);
 	if (n && strcmp(name, n) == 0)
-	    Pt = item;
-	Py_DECREF(item); 	/* iterator item ref must be released */
+	    return item;
     }
-    Py_DECREF(iterator);
 
-    if (Pt) {
+    return NULL;
+}
+
+static PyObject *
+CLIgen_tree(CLIgen *self, PyObject *args)
+{
+    char *name;
+    PyObject *Pt;
+
+    if (!PyArg_ParseTuple(args, "s", &name))
+        return NULL;
+
+    if ((Pt = CLIgen_tree_find(self, name)) != NULL) {
 	Py_INCREF(Pt);
 	return Pt;
     }
@@ -673,18 +950,97 @@ CLIgen_tree_active(CLIgen *self)
 
 
 
+/*
+ * Parse a command line in the active parse-tree and evaluate its callback,
+ * like cliread_eval() does with a line read from the terminal. The match
+ * time is recorded by the callback, or here if there is none to run.
+ * A tree not added through a ParseTree object is used as is, without
+ * coverage counts.
+ */
+static int
+CLIgen_parse_eval(CLIgen *self, char *line, int *cb_ret)
+{
+    char *name;
+    PyObject *Pt = NULL;
+    parse_tree *pt;
+    cg_obj *match;
+    cvec *vr;
+    int retval;
+    uint64_t t0;
+    StatsEntry *se;
+    CLIgen_handle ch = self->handle;
+
+    if ((name = cligen_tree_active(ch->ch_cligen)) != NULL)
+	Pt = CLIgen_tree_find(self, name);
+    if (Pt != NULL)
+	pt = ParseTree_pt(Pt);
+    else if ((pt = cligen_tree_active_get(ch->ch_cligen)) == NULL)
+	return CG_ERROR;
+    if ((vr = cvec_new(0)) == NULL)
+	return CG_ERROR;
+
+    TRACE(ch->ch_trace, TRACE_LINE, 'B', line);
+    t0 = Stats_now();
+    retval = cliread_parse(ch->ch_cligen, line, pt, &match, vr);
+    ch->ch_match_ns = Stats_now() - t0;
+    ch->ch_match_pending = 1;
+    PROBE_MATCH(line, retval, ch->ch_match_ns);
+    METRICS_ADD(ch->ch_metrics, mp_lines, 1);
+    if (retval == CG_NOMATCH)
+	METRICS_ADD(ch->ch_metrics, mp_nomatch, 1);
+    else if (retval > CG_MATCH)
+	METRICS_ADD(ch->ch_metrics, mp_ambiguous, 1);
+    if (retval == CG_MATCH) {
+	if (Pt != NULL && ParseTree_hit(Pt, match) < 0)
+	    PyErr_Clear();
+	*cb_ret = cligen_eval(ch->ch_cligen, match, vr);
+    }
+    cvec_free(vr);
+    if (ch->ch_match_pending) {
+	ch->ch_match_pending = 0;
+	if ((se = Stats_entry(ch->ch_stats, NULL)) != NULL)
+	    Stats_record(se, STATS_MATCH, ch->ch_match_ns);
+    }
+    TRACE(ch->ch_trace, TRACE_LINE, 'E', line);
+
+    return retval;
+}
+
 static PyObject *
 CLIgen_eval(CLIgen *self)
 {
     char *line;
+    char *prefix;
+    PyObject *Ret;
+    int ret;
     int cb_ret;
     int retval = CG_ERROR;
     
     while (!cligen_exiting(self->handle->ch_cligen)){
-	switch (cliread_eval(self->handle->ch_cligen, &line, &cb_ret)){
-	case CG_EOF: /* eof */
+	/* Background job output, see cligen.py offload_output() */
+	if (PyObject_HasAttrString((PyObject *)self, "_cligen_prompt")) {
+	    if ((Ret = PyObject_CallMethod((PyObject *)self, "_cligen_prompt", NULL)) == NULL)
+		PyErr_Print();
+	    Py_XDECREF(Ret);
+	}
+	Py_BEGIN_ALLOW_THREADS
+	line = cliread(self->handle->ch_cligen);
+	Py_END_ALLOW_THREADS
+	if (line == NULL) /* eof */
 	    goto done;
-	    break;
+	if ((prefix = self->handle->ch_profile_prefix) != NULL &&
+	    strncmp(line, prefix, strlen(prefix)) == 0 &&
+	    (line[strlen(prefix)] == ' ' || line[strlen(prefix)] == '\t')) {
+	    if ((Ret = PyObject_CallMethod((PyObject *)self, "_profile_line",
+					   "s", line + strlen(prefix))) == NULL)
+		PyErr_Print();
+	    Py_XDECREF(Ret);
+	    CLIgen_flush(self->handle);
+	    continue;
+	}
+	ret = CLIgen_parse_eval(self, line, &cb_ret);
+	CLIgen_flush(self->handle);
+	switch (ret){
 	case CG_ERROR: /* cligen match errors */
 	    printf("CLI read error\n");
 	    goto done;
@@ -707,6 +1063,152 @@ CLIgen_eval(CLIgen *self)
     return PyLong_FromLong(retval);
 }
 
+static PyObject *
+_CLIgen_execute(CLIgen *self, PyObject *args)
+{
+    char *line;
+    int ret;
+    int cb_ret = 0;
+    int capture = 1;
+    size_t mark = 0;
+    PyObject *Output = NULL;
+    PyObject *Prof = Py_None;
+    OutputChannel *oc = self->handle->ch_output;
+
+    if (!PyArg_ParseTuple(args, "s|iO", &line, &capture, &Prof))
+        return NULL;
+
+    if (capture)
+	mark = OutputChannel_capture_start(oc);
+    if (Prof != Py_None)
+	self->handle->ch_profile = Prof;
+    ret = CLIgen_parse_eval(self, line, &cb_ret);
+    self->handle->ch_profile = NULL;
+    if (capture) {
+	if ((Output = OutputChannel_capture_end(oc, mark)) == NULL)
+	    return NULL;
+    } else {
+	CLIgen_flush(self->handle);
+	Py_INCREF(Py_None);
+	Output = Py_None;
+    }
+
+    switch (ret) {
+    case CG_MATCH:
+	return Py_BuildValue("(iN)", cb_ret, Output);
+    case CG_NOMATCH:
+	PyErr_Format(PyExc_ValueError, "CLI syntax error in: \"%s\": %s",
+		     line, cligen_nomatch(self->handle->ch_cligen));
+	break;
+    case CG_ERROR:
+	PyErr_SetString(PyExc_RuntimeError, "CLI parse error");
+	break;
+    default:
+	PyErr_SetString(PyExc_ValueError, "Ambigous command");
+	break;
+    }
+    Py_DECREF(Output);
+
+    return NULL;
+}
+
+
+static PyObject *
+CLIgen_profile_prefix_set(CLIgen *self, PyObject *args)
+{
+    char *prefix = NULL;
+    char *dup = NULL;
+
+    if (!PyArg_ParseTuple(args, "z", &prefix))
+        return NULL;
+    if (prefix && (dup = strdup(prefix)) == NULL)
+	return PyErr_NoMemory();
+    free(self->handle->ch_profile_prefix);
+    self->handle->ch_profile_prefix = dup;
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+_CLIgen_stats(CLIgen *self)
+{
+    return Stats_dict(self->handle->ch_stats);
+}
+
+static PyObject *
+CLIgen_stats_reset(CLIgen *self)
+{
+    Stats_reset(self->handle->ch_stats);
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+CLIgen_trace_start(CLIgen *self, PyObject *args)
+{
+    int size = 65536;
+    int lines = 0;
+    Trace *tr;
+
+    if (!PyArg_ParseTuple(args, "|ii", &size, &lines))
+        return NULL;
+    if (size <= 0) {
+	PyErr_SetString(PyExc_ValueError, "size must be positive");
+	return NULL;
+    }
+    if ((tr = Trace_new(size, lines)) == NULL)
+	return PyErr_NoMemory();
+
+    Trace_free(self->handle->ch_trace);
+    self->handle->ch_trace = tr;
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+CLIgen_trace_stop(CLIgen *self)
+{
+    if (self->handle->ch_trace)
+	self->handle->ch_trace->tr_on = 0;
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+_CLIgen_trace_events(CLIgen *self)
+{
+    return Trace_list(self->handle->ch_trace);
+}
+
+/*
+ * The current metrics file is released first, so that it can be opened
+ * again by the same instance.
+ */
+static PyObject *
+CLIgen_metrics_open(CLIgen *self, PyObject *args)
+{
+    char *path;
+    Metrics *m;
+    int fd;
+
+    if (!PyArg_ParseTuple(args, "s", &path))
+        return NULL;
+    Metrics_close(self->handle->ch_metrics, self->handle->ch_metrics_fd);
+    self->handle->ch_metrics = NULL;
+    if ((m = Metrics_open(path, &fd)) == NULL)
+	return PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+    self->handle->ch_metrics = m;
+    self->handle->ch_metrics_fd = fd;
+    METRICS_SET(m, mp_output_bytes, OutputChannel_bytes(self->handle->ch_output));
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+CLIgen_metrics_close(CLIgen *self)
+{
+    Metrics_close(self->handle->ch_metrics, self->handle->ch_metrics_fd);
+    self->handle->ch_metrics = NULL;
+    Py_RETURN_NONE;
+}
+
 
 static PyMethodDef CLIgen_methods[] = {
     {"_ptlist", (PyCFunction)_CLIgen_ptlist, METH_NOARGS,
@@ -721,6 +1223,16 @@ static PyMethodDef CLIgen_methods[] = {
      "Set CLIgen prompt"
     },
 
+    {"_buf", (PyCFunction)_CLIgen_buf, METH_NOARGS,
+     "Get the command line being edited"
+    },
+    {"_regfd", (PyCFunction)_CLIgen_regfd, METH_VARARGS,
+     "Call _cligen_fd(fd) when fd is readable at the prompt"
+    },
+    {"_unregfd", (PyCFunction)_CLIgen_unregfd, METH_VARARGS,
+     "Stop watching a file registered with _regfd()"
+    },
+
     {"comment", (PyCFunction)CLIgen_comment, METH_NOARGS,
      "Get CLIgen comment character"
     },
@@ -773,6 +1285,36 @@ static PyMethodDef CLIgen_methods[] = {
     {"_output", (PyCFunction)_CLIgen_output, METH_VARARGS,
      "CLIgen terminal output function. All outout should be made via this method"
     },
+    {"output_flush", (PyCFunction)CLIgen_output_flush, METH_NOARGS,
+     "Write out output buffered by the CLIgen output channel"
+    },
+    {"output_bytes", (PyCFunction)CLIgen_output_bytes, METH_NOARGS,
+     "Get total number of bytes written via the CLIgen output channel"
+    },
+
+    {"_stats", (PyCFunction)_CLIgen_stats, METH_NOARGS,
+     "Get command latency statistics"
+    },
+    {"stats_reset", (PyCFunction)CLIgen_stats_reset, METH_NOARGS,
+     "Reset command latency statistics"
+    },
+
+    {"trace_start", (PyCFunction)CLIgen_trace_start, METH_VARARGS,
+     "Start tracing events into a new ring buffer of the given size, "
+     "with command lines as line event names if the second argument is true"
+    },
+    {"trace_stop", (PyCFunction)CLIgen_trace_stop, METH_NOARGS,
+     "Stop tracing events, keeping those recorded"
+    },
+    {"_trace_events", (PyCFunction)_CLIgen_trace_events, METH_NOARGS,
+     "Get the recorded trace events"
+    },
+    {"metrics_open", (PyCFunction)CLIgen_metrics_open, METH_VARARGS,
+     "Publish counters in a metrics file mapped and locked at the given path"
+    },
+    {"metrics_close", (PyCFunction)CLIgen_metrics_close, METH_NOARGS,
+     "Stop publishing counters, leaving the metrics file as is"
+    },
 
     {"exiting", (PyCFunction)CLIgen_exiting, METH_NOARGS,
      "Check if CLIgen is exiting"
@@ -785,6 +1327,13 @@ static PyMethodDef CLIgen_methods[] = {
     {"eval", (PyCFunction)CLIgen_eval, METH_NOARGS,
      "CLIgen command evaluation loop"
     },
+    {"_execute", (PyCFunction)_CLIgen_execute, METH_VARARGS,
+     "Execute a command line, optionally capturing its output"
+    },
+
+    {"profile_prefix_set", (PyCFunction)CLIgen_profile_prefix_set, METH_VARARGS,
+     "Set the prefix of lines to profile in eval(), or None to disable"
+    },
 
     {"tree", (PyCFunction)CLIgen_tree, METH_VARARGS,
      "Get ParseTree by name"
@@ -854,16 +1403,32 @@ PyTypeObject CLIgen_Type = {
  * Module methods
  */
 static PyMethodDef cligen_methods[] = {
+    {"_parse_bulk", (PyCFunction)CgVar_parse_bulk, METH_VARARGS, 
+     "Parse a sequence of strings as one CLIgen type"
+    },
+    {"_decode", (PyCFunction)Cvec_decode, METH_VARARGS, 
+     "Decode a CgVar or Cvec from the binary wire format"
+    },
+    {"_memory", (PyCFunction)Mem_dict, METH_NOARGS, 
+     "Get the native memory in use by the binding per kind"
+    },
 
     {NULL}  /* Sentinel */
 };
 
 
+static void
+cligen_free(void *m)
+{
+    CgVar_fini_object();
+}
+
 MOD_INIT(_cligen)
 {
     PyObject* m;
 
-    MOD_DEF(m, "_cligen", "Python bindings for CLIgen", cligen_methods);
+    MOD_DEF(m, "_cligen", "Python bindings for CLIgen", cligen_methods,
+	    cligen_free);
     if (m == NULL)
         return MOD_ERROR_VAL;
 
@@ -872,6 +1437,7 @@ MOD_INIT(_cligen)
 
     Py_INCREF(&CLIgen_Type);
     PyModule_AddObject(m, "CLIgen", (PyObject *)&CLIgen_Type);
+    PyModule_AddIntConstant(m, (char *) "MEMORY_DOMAIN", MEM_DOMAIN);
 
 
     if (CgVar_init_object(m) < 0)
@@ -30,9 +30,10 @@
   #define MOD_ERROR_VAL NULL
   #define MOD_SUCCESS_VAL(val) val
   #define MOD_INIT(name) PyMODINIT_FUNC PyInit_##name(void)
-  #define MOD_DEF(ob, name, doc, methods) \
+  #define MOD_DEF(ob, name, doc, methods, free) \
           static struct PyModuleDef moduledef = { \
-            PyModuleDef_HEAD_INIT, name, doc, -1, methods, }; \
+            PyModuleDef_HEAD_INIT, name, doc, -1, methods, \
+            NULL, NULL, NULL, free }; \
           ob = PyModule_Create(&moduledef);
   #define PyInt_FromLong(l)  PyLong_FromLong(l)
 
@@ -40,7 +41,7 @@
   #define MOD_ERROR_VAL
   #define MOD_SUCCESS_VAL(val)
   #define MOD_INIT(name) void init##name(void)
-  #define MOD_DEF(ob, name, doc, methods) \
+  #define MOD_DEF(ob, name, doc, methods, free) \
           ob = Py_InitModule3(name, methods, doc);
 
   #define PyExc_FileNotFoundError PyExc_IOError
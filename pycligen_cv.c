@@ -20,6 +20,7 @@
  * <http://www.gnu.org/licenses/>.
  */
 
+#define PY_SSIZE_T_CLEAN
 #include <Python.h>
 
 #include <sys/socket.h>
@@ -30,19 +31,43 @@
 
 #include "pycligen.h"
 #include "pycligen_cv.h"
+#include "pycligen_cvec.h"
+#include "pycligen_mem.h"
 
 
 typedef struct {
     PyObject_HEAD
     cg_var *cv;
+    PyObject *name;   /* Interned name, NULL if not yet looked up */
+    int shared;       /* Shared between Cvec objects, see CgVar_share() */
 } CgVar;
 
+/*
+ * Incremented whenever a variable is renamed, so containers indexing
+ * variables by name know when to rebuild their index.
+ */
+uint64_t CgVar_name_epoch = 0;
+
+
+/*
+ * Replace the cg_var of self with cv, freeing the old one
+ */
+static void
+CgVar_cv_replace(CgVar *self, cg_var *cv)
+{
+    Mem_untrack(MEM_CGVAR, self->cv, MEM_CGVAR_SIZE);
+    cv_free(self->cv);
+    self->cv = cv;
+    Mem_track(MEM_CGVAR, cv, MEM_CGVAR_SIZE);
+}
 
 static void
 CgVar_dealloc(CgVar* self)
 {
 //    puts("CgVar_dealloc");
+    Mem_untrack(MEM_CGVAR, self->cv, MEM_CGVAR_SIZE);
     cv_free(self->cv);
+    Py_XDECREF(self->name);
     Py_TYPE(self)->tp_free((PyObject*)self);
 }
 
@@ -59,6 +84,7 @@ CgVar_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
             Py_DECREF(self);
             return NULL;
         }
+        Mem_track(MEM_CGVAR, self->cv, MEM_CGVAR_SIZE);
     }
     return (PyObject *)self;
 }
@@ -86,6 +112,10 @@ CgVar_init(CgVar *self, PyObject *args, PyObject *kwds)
 	PyErr_SetNone(PyExc_MemoryError);
 	return -1;
     }
+    if (self->name) {
+	Py_CLEAR(self->name);
+	CgVar_name_epoch++;
+    }
 
     /* Parse value if specified */
     if (value && (Str = PyObject_Str(value))) {
@@ -136,15 +166,14 @@ CgVar_type_verify(CgVar *self, enum cv_type type)
 static PyObject *
 _CgVar_name_get(CgVar *self)
 {
-    char *str;
+    PyObject *Name;
 
     assert(self->cv);
 
-    str = cv_name_get(self->cv);
-    if (str == NULL)
-	Py_RETURN_NONE;
+    if ((Name = CgVar_name((PyObject *)self)) != NULL)
+	Py_INCREF(Name);
     
-    return StringFromString(str);
+    return Name;
 }
 
 static PyObject *
@@ -161,6 +190,8 @@ _CgVar_name_set(CgVar *self, PyObject *args)
         PyErr_SetString(PyExc_MemoryError, "string_set");
         return NULL;
     }
+    Py_CLEAR(self->name);
+    CgVar_name_epoch++;
     
     return StringFromString(str);
 }
@@ -192,8 +223,7 @@ _CgVar_type_set(CgVar *self, PyObject *args)
 	    PyErr_SetString(PyExc_MemoryError, "cv_new");
 	    return NULL;
 	}
-	cv_free(self->cv);
-	self->cv = cv;
+	CgVar_cv_replace(self, cv);
     }
     
     return PyLong_FromLong(type);
@@ -497,6 +527,7 @@ static PyObject *
 _CgVar_dec64_set(CgVar *self, PyObject *args)
 {
     PyObject *Dec64;
+    PyObject *Ret;
     int n;
 
     if (CgVar_type_verify(self, CGV_DEC64))
@@ -506,8 +537,9 @@ _CgVar_dec64_set(CgVar *self, PyObject *args)
         return NULL;
 
     cv_dec64_n_set(self->cv, n);
-    if (PyObject_CallMethod((PyObject *)self, "_parse", "O", Dec64) == NULL)
+    if ((Ret = PyObject_CallMethod((PyObject *)self, "_parse", "O", Dec64)) == NULL)
 	return NULL;
+    Py_DECREF(Ret);
     
     return _CgVar_dec64_get(self);
 }
@@ -619,253 +651,605 @@ _CgVar_string_set(CgVar *self, PyObject *args)
     return StringFromString(str);
 }
 
+/*
+ * Keep internal references to the classes used to represent addresses and
+ * UUIDs so they are only looked up once.
+ */
 static PyObject *
-_CgVar_ipv4addr_get(CgVar *self)
+CgVar_class(PyObject **cache, const char *module, const char *name)
+{
+    PyObject *mod;
+
+    if (*cache == NULL) {
+	if ((mod = PyImport_ImportModule(module)) == NULL)
+	    return NULL;
+	*cache = PyObject_GetAttrString(mod, name);
+	Py_DECREF(mod);
+    }
+
+    return *cache;
+}
+
+static PyObject *IPv4Address_Class = NULL;
+static PyObject *IPv6Address_Class = NULL;
+static PyObject *IPv4Interface_Class = NULL;
+static PyObject *IPv6Interface_Class = NULL;
+static PyObject *UUID_Class = NULL;
+
+/*
+ * Create an ipaddress object of class Class from a packed address and
+ * optionally a mask length (if masklen >= 0).
+ */
+static PyObject *
+CgVar_ipaddress(PyObject *Class, const void *addr, size_t len, int masklen)
+{
+    PyObject *ret;
+    PyObject *Packed;
+
+    if (Class == NULL)
+	return NULL;
+    if ((Packed = PyBytes_FromStringAndSize(addr, len)) == NULL)
+	return NULL;
+    if (masklen < 0)
+	ret = PyObject_CallFunctionObjArgs(Class, Packed, NULL);
+    else
+	ret = PyObject_CallFunction(Class, "((Oi))", Packed, masklen);
+    Py_DECREF(Packed);
+
+    return ret;
+}
+
+/*
+ * Get the packed network byte order representation of an address given as
+ * an int, a bytes object or an object with a 'packed' attribute such as
+ * ipaddress.IPv4Address.
+ */
+static int
+CgVar_packed(PyObject *Addr, void *dst, size_t len)
 {
-   struct in_addr *addr;
-    char addrp[INET_ADDRSTRLEN];
+    PyObject *Packed;
+
+    if (PyLong_Check(Addr))
+	Packed = PyObject_CallMethod(Addr, "to_bytes", "ns", (Py_ssize_t)len, 
+				     "big");
+    else if (PyBytes_Check(Addr)) {
+	Py_INCREF(Addr);
+	Packed = Addr;
+    } else 
+	Packed = PyObject_GetAttrString(Addr, "packed");
+    if (Packed == NULL) {
+	if (PyErr_ExceptionMatches(PyExc_OverflowError) ||
+	    PyErr_ExceptionMatches(PyExc_AttributeError)) {
+	    PyErr_Clear();
+	    PyErr_SetString(PyExc_ValueError, "invalid address");
+	}
+	return -1;
+    }
+    if (!PyBytes_Check(Packed) || (size_t)PyBytes_GET_SIZE(Packed) != len) {
+	PyErr_SetString(PyExc_ValueError, "invalid address");
+	Py_DECREF(Packed);
+	return -1;
+    }
+    memcpy(dst, PyBytes_AS_STRING(Packed), len);
+    Py_DECREF(Packed);
+
+    return 0;
+}
 
+static int
+CgVar_ipv4_verify(CgVar *self)
+{
     if (cv_type_get(self->cv) != CGV_IPV4ADDR && 
 	cv_type_get(self->cv) != CGV_IPV4PFX) {
         PyErr_SetString(PyExc_TypeError, "invalid type");
-        return NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+static int
+CgVar_ipv6_verify(CgVar *self)
+{
+    if (cv_type_get(self->cv) != CGV_IPV6ADDR && 
+	cv_type_get(self->cv) != CGV_IPV6PFX) {
+        PyErr_SetString(PyExc_TypeError, "invalid type");
+        return -1;
     }
+
+    return 0;
+}
+
+static PyObject *
+_CgVar_ipv4addr_get(CgVar *self)
+{
+    struct in_addr *addr;
+
+    if (CgVar_ipv4_verify(self))
+        return NULL;
 	
     if ((addr = cv_ipv4addr_get(self->cv)) == NULL)
 	Py_RETURN_NONE;
     
-    return StringFromString(inet_ntop(AF_INET, addr, addrp, INET_ADDRSTRLEN));
+    return CgVar_ipaddress(CgVar_class(&IPv4Address_Class, "ipaddress", 
+				       "IPv4Address"),
+			   addr, sizeof(*addr), -1);
 }
 
 static PyObject *
 _CgVar_ipv4masklen_get(CgVar *self)
 {
-    if (cv_type_get(self->cv) != CGV_IPV4ADDR && 
-	cv_type_get(self->cv) != CGV_IPV4PFX) {
-        PyErr_SetString(PyExc_TypeError, "invalid type");
+    if (CgVar_ipv4_verify(self))
         return NULL;
-    }
 	
     return PyLong_FromLong(cv_ipv4masklen_get(self->cv));
 }
 
-#if notimplemented
 static PyObject *
 _CgVar_ipv4addr_set(CgVar *self, PyObject *args)
 {
-    PyObject * addr;
+    PyObject *Addr;
+    struct in_addr *addr;
 
-    if (cv_type_get(self->cv) != CGV_IPV4ADDR && 
-	cv_type_get(self->cv) != CGV_IPV4PFX) {
-        PyErr_SetString(PyExc_TypeError, "invalid type");
+    if (CgVar_ipv4_verify(self))
         return NULL;
-    }
 	
-    if (!PyArg_ParseTuple(args, "O", &addr))
+    if (!PyArg_ParseTuple(args, "O", &Addr))
         return NULL;
     
-    PyErr_SetNone(PyExc_NotImplementedError);
-    return NULL;
+    if ((addr = cv_ipv4addr_get(self->cv)) == NULL) {
+        PyErr_SetString(PyExc_AttributeError, "cv");
+	return NULL;
+    }
+    if (CgVar_packed(Addr, addr, sizeof(*addr)) < 0)
+	return NULL;
+
+    return _CgVar_ipv4addr_get(self);
+}
+
+static PyObject *
+_CgVar_ipv4masklen_set(CgVar *self, PyObject *args)
+{
+    int masklen;
+
+    if (CgVar_type_verify(self, CGV_IPV4PFX))
+        return NULL;
+	
+    if (!PyArg_ParseTuple(args, "i", &masklen))
+        return NULL;
+    if (masklen < 0 || masklen > 32) {
+	PyErr_SetString(PyExc_ValueError, "invalid mask length");
+	return NULL;
+    }
+
+    return PyLong_FromLong(cv_ipv4masklen_set(self->cv, masklen));
 }
-#endif /* notimplemented */
 
 static PyObject *
 _CgVar_ipv6addr_get(CgVar *self)
 {
     struct in6_addr *addr;
-    char addrp[INET6_ADDRSTRLEN];
 
-    if (cv_type_get(self->cv) != CGV_IPV6ADDR && 
-	cv_type_get(self->cv) != CGV_IPV6PFX) {
-        PyErr_SetString(PyExc_TypeError, "invalid type");
+    if (CgVar_ipv6_verify(self))
         return NULL;
-    }
 	
     if ((addr = cv_ipv6addr_get(self->cv)) == NULL)
 	Py_RETURN_NONE;
     
-    return StringFromString(inet_ntop(AF_INET6, addr, addrp, INET6_ADDRSTRLEN));
+    return CgVar_ipaddress(CgVar_class(&IPv6Address_Class, "ipaddress", 
+				       "IPv6Address"),
+			   addr, sizeof(*addr), -1);
 }
 
 static PyObject *
 _CgVar_ipv6masklen_get(CgVar *self)
 {
-    if (cv_type_get(self->cv) != CGV_IPV6ADDR && 
-	cv_type_get(self->cv) != CGV_IPV6PFX) {
-        PyErr_SetString(PyExc_TypeError, "invalid type");
+    if (CgVar_ipv6_verify(self))
         return NULL;
-    }
 	
     return PyLong_FromLong(cv_ipv6masklen_get(self->cv));
 }
 
-#if notimplemented
 static PyObject *
 _CgVar_ipv6addr_set(CgVar *self, PyObject *args)
 {
-    PyObject * addr;
+    PyObject *Addr;
+    struct in6_addr *addr;
 
-    if (cv_type_get(self->cv) != CGV_IPV6ADDR && 
-	cv_type_get(self->cv) != CGV_IPV6PFX) {
-        PyErr_SetString(PyExc_TypeError, "invalid type");
+    if (CgVar_ipv6_verify(self))
+        return NULL;
+	
+    if (!PyArg_ParseTuple(args, "O", &Addr))
         return NULL;
-    }
     
-    PyErr_SetNone(PyExc_NotImplementedError);
-    return NULL;
+    if ((addr = cv_ipv6addr_get(self->cv)) == NULL) {
+        PyErr_SetString(PyExc_AttributeError, "cv");
+	return NULL;
+    }
+    if (CgVar_packed(Addr, addr, sizeof(*addr)) < 0)
+	return NULL;
+
+    return _CgVar_ipv6addr_get(self);
+}
+
+static PyObject *
+_CgVar_ipv6masklen_set(CgVar *self, PyObject *args)
+{
+    int masklen;
+
+    if (CgVar_type_verify(self, CGV_IPV6PFX))
+        return NULL;
+	
+    if (!PyArg_ParseTuple(args, "i", &masklen))
+        return NULL;
+    if (masklen < 0 || masklen > 128) {
+	PyErr_SetString(PyExc_ValueError, "invalid mask length");
+	return NULL;
+    }
+
+    return PyLong_FromLong(cv_ipv6masklen_set(self->cv, masklen));
 }
-#endif /* notimplemented */
 
-#define MACADDR_STRLEN 12 /* 6 * "xx" */
 static PyObject *
 _CgVar_mac_get(CgVar *self)
 {
-    char *m;
-    char mac[MACADDR_STRLEN + 1];
-    unsigned long l;
+    unsigned char *m;
+    uint64_t mac;
 
     if (CgVar_type_verify(self, CGV_MACADDR))
         return NULL;
 	
+    m = (unsigned char *)cv_mac_get(self->cv);
+    mac = ((uint64_t)m[0] << 40) | ((uint64_t)m[1] << 32) |
+	((uint64_t)m[2] << 24) | ((uint64_t)m[3] << 16) |
+	((uint64_t)m[4] << 8) | m[5];
+
+    return PyLong_FromUnsignedLongLong(mac);
+}
+
+static PyObject *
+_CgVar_mac_set(CgVar *self, PyObject *args)
+{
+    int i;
+    char *m;
+    uint64_t mac;
+    PyObject *Mac;
+
+    if (CgVar_type_verify(self, CGV_MACADDR))
+        return NULL;
+
+    /* "K" would silently wrap negative and too large values */
+    if (!PyArg_ParseTuple(args, "O!", &PyLong_Type, &Mac))
+        return NULL;
+    mac = PyLong_AsUnsignedLongLong(Mac);
+    if (mac == (uint64_t)-1 && PyErr_Occurred()) {
+	if (!PyErr_ExceptionMatches(PyExc_OverflowError))
+	    return NULL;
+	PyErr_Clear();
+	mac = UINT64_MAX;
+    }
+    if (mac > 0xffffffffffffULL) {
+	PyErr_SetString(PyExc_ValueError, 
+			"value out of range for type 'macaddr'");
+	return NULL;
+    }
+
     m = cv_mac_get(self->cv);
-    snprintf(mac, sizeof(mac),
-	     "%02x%02x%02x%02x%02x%02x", 
-	     (unsigned char)m[0],
-	     (unsigned char)m[1],
-	     (unsigned char)m[2],
-	     (unsigned char)m[3],
-	     (unsigned char)m[4],
-	     (unsigned char)m[5]);
+    for (i = 5; i >= 0; i--, mac >>= 8)
+	m[i] = mac & 0xff;
     
-    l = strtoul(mac, NULL, 16);
-
-    return PyLong_FromLong(l);
+    return _CgVar_mac_get(self);
 }
 
 static PyObject *
 _CgVar_uuid_get(CgVar *self)
 {
-    char *uuidstr;
-    PyObject *uuid;
-    PyObject *mod;
-    PyObject *ret;
+    PyObject *Class;
+    PyObject *Bytes;
+    PyObject *Args;
+    PyObject *Kwargs;
+    PyObject *ret = NULL;
 
     if (CgVar_type_verify(self, CGV_UUID))
         return NULL;
 
-    if ((uuidstr = cv2str_dup(self->cv)) == NULL)
-	return PyErr_NoMemory();
-    uuid = StringFromString(uuidstr);
-    free(uuidstr);
-    if (uuid == NULL)
+    if ((Class = CgVar_class(&UUID_Class, "uuid", "UUID")) == NULL)
 	return NULL;
+    if ((Args = PyTuple_New(0)) == NULL)
+	return NULL;
+    Bytes = PyBytes_FromStringAndSize((char *)cv_uuid_get(self->cv), 16);
+    if (Bytes == NULL)
+	goto done;
+    if ((Kwargs = Py_BuildValue("{sO}", "bytes", Bytes)) == NULL)
+	goto done;
+    ret = PyObject_Call(Class, Args, Kwargs);
+    Py_DECREF(Kwargs);
+
+done:
+    Py_XDECREF(Bytes);
+    Py_DECREF(Args);
+    return ret;
+}
+
+static PyObject *
+_CgVar_uuid_set(CgVar *self, PyObject *args)
+{
+    PyObject *Uuid;
+    PyObject *Bytes;
 
-    if ((mod = PyImport_ImportModule("uuid")) == NULL) {
-	Py_DECREF(uuid);
-	return NULL; 
+    if (CgVar_type_verify(self, CGV_UUID))
+        return NULL;
+
+    if (!PyArg_ParseTuple(args, "O", &Uuid))
+        return NULL;
+
+    if (PyBytes_Check(Uuid)) {
+	Py_INCREF(Uuid);
+	Bytes = Uuid;
+    } else if ((Bytes = PyObject_GetAttrString(Uuid, "bytes")) == NULL)
+	return NULL;
+    if (!PyBytes_Check(Bytes) || PyBytes_GET_SIZE(Bytes) != 16) {
+	PyErr_SetString(PyExc_ValueError, "invalid uuid");
+	Py_DECREF(Bytes);
+	return NULL;
     }
-    
-    ret = PyObject_CallMethod(mod, "UUID", "O", uuid);
-    Py_DECREF(uuid);
-    Py_DECREF(mod);
-    
-    return ret;
+    memcpy(cv_uuid_get(self->cv), PyBytes_AS_STRING(Bytes), 16);
+    Py_DECREF(Bytes);
+
+    return _CgVar_uuid_get(self);
 }
 
 static PyObject *
 _CgVar_time_get(CgVar *self)
 {
-    size_t len;
-    char *fstr;
     struct timeval t;
-    PyObject *tstr;
-    PyObject *tobj;
 
     if (CgVar_type_verify(self, CGV_TIME))
         return NULL;
 
     t = cv_time_get(self->cv);
-    len = snprintf(NULL, 0, "%ld",  t.tv_sec) +
-	strlen(".") + snprintf(NULL, 0, "%ld",  t.tv_usec) + 1;
-    
-    if ((fstr = malloc(len)) == NULL)
-	return PyErr_NoMemory();
-    snprintf(fstr, len, "%ld.%ld",  t.tv_sec, t.tv_usec);
-
-    tstr = StringFromString(fstr);
-    free(fstr);
-    if (tstr == NULL)
-	return NULL;
-
-    tobj = PyFloat_FromString(tstr);
-    Py_DECREF(tstr);
 
-    return tobj;
+    return PyFloat_FromDouble(t.tv_sec + t.tv_usec / 1000000.0);
 }
 
 static PyObject *
 _CgVar_time_set(CgVar *self, PyObject *args)
 {
-    char *secs;
-    char *usecs;
+    double secs;
     struct timeval t;
 
     if (CgVar_type_verify(self, CGV_TIME))
         return NULL;
 
-    if (!PyArg_ParseTuple(args, "s", &secs))
+    if (!PyArg_ParseTuple(args, "d", &secs))
         return NULL;
-
-    if ((usecs  = strchr(secs, '.')) != NULL) {
-	*usecs++ = '\0';
-	t.tv_usec = strtoul(usecs, NULL, 10);
+    /* Keeps the cast to time_t defined, also for a 32-bit time_t */
+    if (!isfinite(secs) ||
+	fabs(secs) >= (sizeof(time_t) == 4 ? 2147483647.0 : 9.2e18)) {
+	PyErr_SetString(PyExc_ValueError, "value out of range for type 'time'");
+	return NULL;
     }
-    t.tv_sec = strtoul(secs, NULL, 10);
 
+    /* Round down so tv_usec is in [0, 1000000) for negative values too */
+    t.tv_sec = (time_t)floor(secs);
+    t.tv_usec = (long)((secs - floor(secs)) * 1000000.0 + 0.5);
+    if (t.tv_usec >= 1000000) {
+	t.tv_sec++;
+	t.tv_usec -= 1000000;
+    }
     cv_time_set(self->cv, t);
     
     return _CgVar_time_get(self);
 }
 
+static int
+CgVar_type_isnumeric(enum cv_type type)
+{
+    switch (type) {
+    case CGV_INT8:
+    case CGV_INT16:
+    case CGV_INT32:
+    case CGV_INT64:
+    case CGV_UINT8:
+    case CGV_UINT16:
+    case CGV_UINT32:
+    case CGV_UINT64:
+    case CGV_DEC64:
+	return 1;
+    default:
+	return 0;
+    }
+}
+
+static int
+CgVar_type_isstring(enum cv_type type)
+{
+    switch (type) {
+    case CGV_STRING:
+    case CGV_REST:
+    case CGV_INTERFACE:
+    case CGV_URL:
+	return 1;
+    default:
+	return 0;
+    }
+}
+
+/*
+ * Fixed size types hold their value within the cg_var and can be updated in
+ * place. Other types own allocated memory.
+ */
+static int
+CgVar_type_isfixed(enum cv_type type)
+{
+    switch (type) {
+    case CGV_INT8:
+    case CGV_INT16:
+    case CGV_INT32:
+    case CGV_INT64:
+    case CGV_UINT8:
+    case CGV_UINT16:
+    case CGV_UINT32:
+    case CGV_UINT64:
+    case CGV_DEC64:
+    case CGV_BOOL:
+    case CGV_IPV4ADDR:
+    case CGV_IPV4PFX:
+    case CGV_IPV6ADDR:
+    case CGV_IPV6PFX:
+    case CGV_MACADDR:
+    case CGV_UUID:
+    case CGV_TIME:
+	return 1;
+    default:
+	return 0;
+    }
+}
+
+/*
+ * Copy the value of src to self->cv, which must be of the same type. Fixed
+ * size values and strings are copied into the existing cg_var, other types
+ * replace it with a copy of src keeping the name of self.
+ */
+static int
+CgVar_value_copy(CgVar *self, cg_var *src)
+{
+    cg_var *dst = self->cv;
+    cg_var *cv;
+
+    switch (cv_type_get(src)) {
+    case CGV_INT8:   cv_int8_set(dst, cv_int8_get(src)); break;
+    case CGV_INT16:  cv_int16_set(dst, cv_int16_get(src)); break;
+    case CGV_INT32:  cv_int32_set(dst, cv_int32_get(src)); break;
+    case CGV_INT64:  cv_int64_set(dst, cv_int64_get(src)); break;
+    case CGV_UINT8:  cv_uint8_set(dst, cv_uint8_get(src)); break;
+    case CGV_UINT16: cv_uint16_set(dst, cv_uint16_get(src)); break;
+    case CGV_UINT32: cv_uint32_set(dst, cv_uint32_get(src)); break;
+    case CGV_UINT64: cv_uint64_set(dst, cv_uint64_get(src)); break;
+    case CGV_BOOL:   cv_bool_set(dst, cv_bool_get(src)); break;
+    case CGV_DEC64:
+	cv_dec64_n_set(dst, cv_dec64_n_get(src));
+	cv_dec64_i_set(dst, cv_dec64_i_get(src));
+	break;
+    case CGV_IPV4ADDR:
+    case CGV_IPV4PFX:
+	memcpy(cv_ipv4addr_get(dst), cv_ipv4addr_get(src), 
+	       sizeof(struct in_addr));
+	cv_ipv4masklen_set(dst, cv_ipv4masklen_get(src));
+	break;
+    case CGV_IPV6ADDR:
+    case CGV_IPV6PFX:
+	memcpy(cv_ipv6addr_get(dst), cv_ipv6addr_get(src), 
+	       sizeof(struct in6_addr));
+	cv_ipv6masklen_set(dst, cv_ipv6masklen_get(src));
+	break;
+    case CGV_MACADDR:
+	memcpy(cv_mac_get(dst), cv_mac_get(src), 6);
+	break;
+    case CGV_UUID:
+	memcpy(cv_uuid_get(dst), cv_uuid_get(src), 16);
+	break;
+    case CGV_TIME:
+	cv_time_set(dst, cv_time_get(src));
+	break;
+    case CGV_STRING:
+    case CGV_REST:
+    case CGV_INTERFACE:
+	if (cv_string_set(dst, cv_string_get(src) ? cv_string_get(src) : "")
+	    == NULL) {
+	    PyErr_SetString(PyExc_MemoryError, "string_set");
+	    return -1;
+	}
+	break;
+    default:
+	if ((cv = cv_dup(src)) == NULL ||
+	    cv_name_set(cv, cv_name_get(dst)) == NULL) {
+	    PyErr_SetString(PyExc_MemoryError, "cv_dup");
+	    if (cv)
+		cv_free(cv);
+	    return -1;
+	}
+	CgVar_cv_replace(self, cv);
+	break;
+    }
+
+    return 0;
+}
+
+/*
+ * Scratch cg_var of _CgVar_parse(), created and freed with the module
+ */
+static cg_var *scratch = NULL;
+
+/*
+ * Parse a string into self. Fixed size types are parsed into a scratch
+ * cg_var and copied on success so self is left unchanged if parsing fails,
+ * string types are set directly. Only other types allocate a new cg_var.
+ */
 static PyObject *
 _CgVar_parse(CgVar *self, PyObject *args)
 {
     char *str;
+    char *dot;
+    char buf[8];
     cg_var *cv;
+    enum cv_type type = cv_type_get(self->cv);
 
     if (!PyArg_ParseTuple(args, "s", &str))
         return NULL;
 
-    if ((cv = cv_new(cv_type_get(self->cv))) == NULL) {
-        PyErr_SetString(PyExc_MemoryError, "cv_new");
-	return NULL;
+    if (CgVar_type_isstring(type) && type != CGV_URL) {
+	if (cv_string_set(self->cv, str) == NULL) {
+	    PyErr_SetString(PyExc_MemoryError, "string_set");
+	    return NULL;
+	}
+	Py_RETURN_TRUE;
     }
-     
-    if (cv_name_set(cv, cv_name_get(self->cv)) < 0) {
-        PyErr_SetString(PyExc_MemoryError, "cv_name_set");
-	cv_free(cv);
-	return NULL;
+
+    if (CgVar_type_isfixed(type)) {
+	/* Clear what an earlier parse left, e.g. a prefix mask length */
+	cv_reset(scratch);
+	cv_type_set(scratch, type);
+	cv = scratch;
+    } else {
+	if ((cv = cv_new(type)) == NULL) {
+	    PyErr_SetString(PyExc_MemoryError, "cv_new");
+	    return NULL;
+	}
+	if (cv_name_get(self->cv) && 
+	    cv_name_set(cv, cv_name_get(self->cv)) == NULL) {
+	    PyErr_SetString(PyExc_MemoryError, "cv_name_set");
+	    cv_free(cv);
+	    return NULL;
+	}
     }
     
     /* XXX begin hack */
-    if (cv_type_get(cv) == CGV_BOOL) {  /* CLIgen wants lowercase */
-	if (strlen(str) > 0)
-	    *str = tolower(*str);
-    } else if (cv_type_get(cv) == CGV_DEC64) {
-	char *dot = strrchr(str, '.');
+    if (type == CGV_BOOL) {  /* CLIgen wants lowercase */
+	if (strlen(str) > 0 && strlen(str) < sizeof(buf)) {
+	    strcpy(buf, str);
+	    *buf = tolower(*buf);
+	    str = buf;
+	}
+    } else if (type == CGV_DEC64) {
+	dot = strrchr(str, '.');
 	cv_dec64_n_set(cv, (dot ? strlen(dot+1) : 1));
     }
     /* XXX end hack */
     
     if (cv_parse(str, cv) < 0) {
 	PyErr_Format(PyExc_ValueError, "invalid format for type '%s'",
-		     cv_type2str(cv_type_get(cv)));
-	cv_free(cv);
+		     cv_type2str(type));
+	if (cv != scratch)
+	    cv_free(cv);
 	return NULL;
     }
 
-    cv_free(self->cv);
-    self->cv = cv;
+    if (cv == scratch) {
+	if (CgVar_value_copy(self, scratch) < 0)
+	    return NULL;
+    } else
+	CgVar_cv_replace(self, cv);
 
     Py_RETURN_TRUE;
 }
@@ -890,23 +1274,960 @@ _CgVar__copy__(CgVar *self)
 
 
 /*
- * Internal method: Get cg_var* pointer to self->cv. 
+ * Number protocol.
+ *
+ * Arithmetic works directly on the binary value of the cg_var. Integer
+ * operations are done in int64_t when operands and result fit, anything else
+ * falls back to Python int/float arithmetic. The result is a new CgVar with
+ * the name of the left operand and the "largest" type of the operands.
  */
-static PyObject *
-__CgVar_cv(CgVar *self)
-{
-    PyObject *Cv;
+#define CGV_OP_ADD	0
+#define CGV_OP_SUB	1
+#define CGV_OP_MUL	2
+#define CGV_OP_DIV	3
 
-    if ((Cv = PyCapsule_New((void *)self->cv, NULL, NULL)) == NULL)
-	return NULL;
+static const char *CgVar_opstr[] = { "+", "-", "*", "/" };
 
-    return Cv;
-}
+/*
+ * Get integer value of cv as int64_t. Returns -1 if cv is not an integer
+ * type or its value does not fit.
+ */
+static int
+CgVar_int64(cg_var *cv, int64_t *val)
+{
+    switch (cv_type_get(cv)) {
+    case CGV_INT8:   *val = cv_int8_get(cv); break;
+    case CGV_INT16:  *val = cv_int16_get(cv); break;
+    case CGV_INT32:  *val = cv_int32_get(cv); break;
+    case CGV_INT64:  *val = cv_int64_get(cv); break;
+    case CGV_UINT8:  *val = cv_uint8_get(cv); break;
+    case CGV_UINT16: *val = cv_uint16_get(cv); break;
+    case CGV_UINT32: *val = cv_uint32_get(cv); break;
+    case CGV_UINT64:
+	if (cv_uint64_get(cv) > INT64_MAX)
+	    return -1;
+	*val = cv_uint64_get(cv);
+	break;
+    default:
+	return -1;
+    }
 
+    return 0;
+}
 
-static PyMethodDef CgVar_methods[] = {
-    {"_name_get", (PyCFunction)_CgVar_name_get, METH_NOARGS,
-    "Return the name of the variable"
+/*
+ * Set integer value of cv if within range of its type
+ */
+static int
+CgVar_int64_set(cg_var *cv, int64_t val)
+{
+    enum cv_type type = cv_type_get(cv);
+
+    switch (type) {
+    case CGV_INT8:
+	if (val < INT8_MIN || val > INT8_MAX)
+	    goto range;
+	cv_int8_set(cv, val);
+	break;
+    case CGV_INT16:
+	if (val < INT16_MIN || val > INT16_MAX)
+	    goto range;
+	cv_int16_set(cv, val);
+	break;
+    case CGV_INT32:
+	if (val < INT32_MIN || val > INT32_MAX)
+	    goto range;
+	cv_int32_set(cv, val);
+	break;
+    case CGV_INT64:
+	cv_int64_set(cv, val);
+	break;
+    case CGV_UINT8:
+	if (val < 0 || val > UINT8_MAX)
+	    goto range;
+	cv_uint8_set(cv, val);
+	break;
+    case CGV_UINT16:
+	if (val < 0 || val > UINT16_MAX)
+	    goto range;
+	cv_uint16_set(cv, val);
+	break;
+    case CGV_UINT32:
+	if (val < 0 || val > UINT32_MAX)
+	    goto range;
+	cv_uint32_set(cv, val);
+	break;
+    case CGV_UINT64:
+	if (val < 0)
+	    goto range;
+	cv_uint64_set(cv, val);
+	break;
+    default:
+	PyErr_Format(PyExc_TypeError, "'%s' is not an integer type",
+		     cv_type2str(type));
+	return -1;
+    }
+
+    return 0;
+
+range:
+    PyErr_Format(PyExc_ValueError, "value out of range for type '%s'",
+		 cv_type2str(type));
+    return -1;
+}
+
+/*
+ * Get numeric value of cv as a Python int, or float for CGV_DEC64
+ */
+static PyObject *
+CgVar_number(cg_var *cv)
+{
+    int n;
+    int64_t val;
+    double d;
+
+    if (CgVar_int64(cv, &val) == 0)
+	return PyLong_FromLongLong(val);
+
+    switch (cv_type_get(cv)) {
+    case CGV_UINT64:
+	return PyLong_FromUnsignedLongLong(cv_uint64_get(cv));
+    case CGV_DEC64:
+	d = cv_dec64_i_get(cv);
+	for (n = cv_dec64_n_get(cv); n > 0; n--)
+	    d /= 10;
+	return PyFloat_FromDouble(d);
+    default:
+	PyErr_SetString(PyExc_ValueError, "not a number object");
+	return NULL;
+    }
+}
+
+/*
+ * Set numeric value of cv from a Python int or float. Floats are only
+ * accepted for integer types if integral. CGV_DEC64 values are rounded to
+ * the precision of cv.
+ */
+static int
+CgVar_number_set(cg_var *cv, PyObject *Val)
+{
+    int n;
+    int overflow;
+    int64_t val;
+    uint64_t uval;
+    double d;
+    double scale;
+    PyObject *Long;
+
+    if (cv_type_get(cv) == CGV_DEC64) {
+	if ((d = PyFloat_AsDouble(Val)) == -1.0 && PyErr_Occurred())
+	    return -1;
+	for (scale = 1, n = cv_dec64_n_get(cv); n > 0; n--)
+	    scale *= 10;
+	d *= scale;
+	if (d != d || d >= 9223372036854775807.0 || d <= -9223372036854775808.0) {
+	    PyErr_SetString(PyExc_ValueError,
+			    "value out of range for type 'decimal64'");
+	    return -1;
+	}
+	cv_dec64_i_set(cv, (int64_t)(d < 0 ? d - 0.5 : d + 0.5));
+	return 0;
+    }
+
+    if (!CgVar_type_isnumeric(cv_type_get(cv))) {
+	PyErr_SetString(PyExc_ValueError, "not a number object");
+	return -1;
+    }
+
+    if (PyFloat_Check(Val)) {
+	/* Round half to even, as the old '{:.0f}' formatting did */
+	if ((Long = PyObject_CallMethod(Val, "__round__", NULL)) == NULL)
+	    return -1;
+    } else if (PyLong_Check(Val)) {
+	Py_INCREF(Val);
+	Long = Val;
+    } else {
+	PyErr_SetString(PyExc_TypeError, "value must be int or float");
+	return -1;
+    }
+
+    val = PyLong_AsLongLongAndOverflow(Long, &overflow);
+    if (overflow > 0 && cv_type_get(cv) == CGV_UINT64) {
+	uval = PyLong_AsUnsignedLongLong(Long);
+	Py_DECREF(Long);
+	if (uval == (uint64_t)-1 && PyErr_Occurred()) {
+	    PyErr_SetString(PyExc_ValueError,
+			    "value out of range for type 'uint64'");
+	    return -1;
+	}
+	cv_uint64_set(cv, uval);
+	return 0;
+    }
+    Py_DECREF(Long);
+    if (val == -1 && PyErr_Occurred())
+	return -1;
+    if (overflow) {
+	PyErr_Format(PyExc_ValueError, "value out of range for type '%s'",
+		     cv_type2str(cv_type_get(cv)));
+	return -1;
+    }
+
+    return CgVar_int64_set(cv, val);
+}
+
+/*
+ * Create a new CgVar of 'type', named after 'self', for an operation result
+ */
+static CgVar *
+CgVar_result(CgVar *self, enum cv_type type)
+{
+    CgVar *Cv;
+    char *name;
+
+    if ((Cv = (CgVar *)CgVar_Instance(NULL)) == NULL)
+	return NULL;
+    cv_type_set(Cv->cv, type);
+    if ((name = cv_name_get(self->cv)) != NULL && 
+	cv_name_set(Cv->cv, name) == NULL) {
+	Py_DECREF(Cv);
+	PyErr_NoMemory();
+	return NULL;
+    }
+
+    return Cv;
+}
+
+/*
+ * String concatenation of str(a) and str(b) parsed as 'type'
+ */
+static PyObject *
+CgVar_concat(CgVar *self, PyObject *other, enum cv_type type)
+{
+    CgVar *Cv;
+    PyObject *Str1;
+    PyObject *Str2 = NULL;
+    PyObject *Str = NULL;
+    const char *str;
+
+    if ((Str1 = PyObject_Str((PyObject *)self)) == NULL ||
+	(Str2 = PyObject_Str(other)) == NULL ||
+	(Str = PyUnicode_Concat(Str1, Str2)) == NULL)
+	goto fail;
+    Py_CLEAR(Str1);
+    Py_CLEAR(Str2);
+
+    if ((str = PyUnicode_AsUTF8(Str)) == NULL ||
+	(Cv = CgVar_result(self, type)) == NULL)
+	goto fail;
+    if (cv_parse((char *)str, Cv->cv) < 0) {
+	PyErr_Format(PyExc_ValueError, "invalid format for type '%s'",
+		     cv_type2str(type));
+	Py_DECREF(Cv);
+	goto fail;
+    }
+    Py_DECREF(Str);
+
+    return (PyObject *)Cv;
+
+fail:
+    Py_XDECREF(Str1);
+    Py_XDECREF(Str2);
+    Py_XDECREF(Str);
+    return NULL;
+}
+
+/*
+ * Integer arithmetic on int64_t. Returns -1 if the operands are not both
+ * integers fitting in int64_t or the operation overflows.
+ */
+static int
+CgVar_arith_int64(CgVar *self, PyObject *b, int op, int64_t *z)
+{
+    int overflow;
+    int64_t x;
+    int64_t y;
+
+    if (op == CGV_OP_DIV || CgVar_int64(self->cv, &x) < 0)
+	return -1;
+    if (PyObject_TypeCheck(b, &CgVar_Type)) {
+	if (CgVar_int64(((CgVar *)b)->cv, &y) < 0)
+	    return -1;
+    } else if (PyLong_Check(b)) {
+	y = PyLong_AsLongLongAndOverflow(b, &overflow);
+	if (overflow)
+	    return -1;
+    } else
+	return -1;
+
+    switch (op) {
+    case CGV_OP_ADD: overflow = __builtin_add_overflow(x, y, z); break;
+    case CGV_OP_SUB: overflow = __builtin_sub_overflow(x, y, z); break;
+    default:         overflow = __builtin_mul_overflow(x, y, z); break;
+    }
+
+    return overflow ? -1 : 0;
+}
+
+static PyObject *
+CgVar_arith(PyObject *a, PyObject *b, int op)
+{
+    int n;
+    int64_t z;
+    enum cv_type stype;
+    enum cv_type otype;
+    enum cv_type type;
+    CgVar *self;
+    CgVar *other = NULL;
+    CgVar *Cv;
+    PyObject *X = NULL;
+    PyObject *Y = NULL;
+    PyObject *Z = NULL;
+
+    if (!PyObject_TypeCheck(a, &CgVar_Type))
+	Py_RETURN_NOTIMPLEMENTED;
+    self = (CgVar *)a;
+    stype = otype = cv_type_get(self->cv);
+    if (PyObject_TypeCheck(b, &CgVar_Type)) {
+	other = (CgVar *)b;
+	otype = cv_type_get(other->cv);
+    }
+    type = (stype < otype) ? otype : stype;
+
+    if (!CgVar_type_isnumeric(stype)) {
+	if (op == CGV_OP_ADD && CgVar_type_isstring(stype))
+	    return CgVar_concat(self, b, type);
+	goto unsupported;
+    }
+    if (other) {
+	if (!CgVar_type_isnumeric(otype)) {
+	    if (op == CGV_OP_ADD && CgVar_type_isstring(otype))
+		return CgVar_concat(self, b, type);
+	    goto unsupported;
+	}
+    } else if (op == CGV_OP_ADD && PyUnicode_Check(b))
+	return CgVar_concat(self, b, type);
+    else if (!PyLong_Check(b) && 
+	     !(PyFloat_Check(b) && (op == CGV_OP_MUL || op == CGV_OP_DIV)))
+	Py_RETURN_NOTIMPLEMENTED;
+
+    if ((Cv = CgVar_result(self, type)) == NULL)
+	return NULL;
+
+    /* Fast path, integer arithmetic */
+    if (CgVar_arith_int64(self, b, op, &z) == 0) {
+	if (CgVar_int64_set(Cv->cv, z) < 0)
+	    goto fail;
+	return (PyObject *)Cv;
+    }
+
+    /* Python int/float arithmetic */
+    if (type == CGV_DEC64) {
+	n = (stype == CGV_DEC64) ? cv_dec64_n_get(self->cv) : 0;
+	if (other && otype == CGV_DEC64 && cv_dec64_n_get(other->cv) > n)
+	    n = cv_dec64_n_get(other->cv);
+	cv_dec64_n_set(Cv->cv, n);
+    }
+    if ((X = CgVar_number(self->cv)) == NULL)
+	goto fail;
+    if (other)
+	Y = CgVar_number(other->cv);
+    else {
+	Py_INCREF(b);
+	Y = b;
+    }
+    if (Y == NULL)
+	goto fail;
+    switch (op) {
+    case CGV_OP_ADD: Z = PyNumber_Add(X, Y); break;
+    case CGV_OP_SUB: Z = PyNumber_Subtract(X, Y); break;
+    case CGV_OP_MUL: Z = PyNumber_Multiply(X, Y); break;
+    default:         Z = PyNumber_TrueDivide(X, Y); break;
+    }
+    if (Z == NULL || CgVar_number_set(Cv->cv, Z) < 0)
+	goto fail;
+    Py_DECREF(X);
+    Py_DECREF(Y);
+    Py_DECREF(Z);
+
+    return (PyObject *)Cv;
+
+fail:
+    Py_DECREF(Cv);
+    Py_XDECREF(X);
+    Py_XDECREF(Y);
+    Py_XDECREF(Z);
+    return NULL;
+
+unsupported:
+    PyErr_Format(PyExc_TypeError,
+		 "unsupported operand type(s) for %s: 'CgVar(%s)' and 'CgVar(%s)'",
+		 CgVar_opstr[op], cv_type2str(stype), cv_type2str(otype));
+    return NULL;
+}
+
+static PyObject *
+CgVar_add(PyObject *a, PyObject *b)
+{
+    return CgVar_arith(a, b, CGV_OP_ADD);
+}
+
+static PyObject *
+CgVar_sub(PyObject *a, PyObject *b)
+{
+    return CgVar_arith(a, b, CGV_OP_SUB);
+}
+
+static PyObject *
+CgVar_mul(PyObject *a, PyObject *b)
+{
+    return CgVar_arith(a, b, CGV_OP_MUL);
+}
+
+static PyObject *
+CgVar_truediv(PyObject *a, PyObject *b)
+{
+    return CgVar_arith(a, b, CGV_OP_DIV);
+}
+
+/*
+ * In-place arithmetic updates the value of self. Integer results are stored
+ * directly, anything else is computed as by the binary operation and copied
+ * into self, converted to the type of self if needed.
+ */
+static PyObject *
+CgVar_inplace(PyObject *a, PyObject *b, int op)
+{
+    int64_t z;
+    CgVar *self;
+    PyObject *Result;
+    PyObject *Str;
+    PyObject *ret;
+
+    self = (CgVar *)a;
+
+    if (CgVar_arith_int64(self, b, op, &z) == 0) {
+	if (CgVar_int64_set(self->cv, z) < 0)
+	    return NULL;
+	Py_INCREF(self);
+	return a;
+    }
+
+    /*
+     * Raise rather than return NotImplemented, subclasses also inherit these
+     * functions as sq_inplace_concat which would return it as the result.
+     */
+    if ((Result = CgVar_arith(a, b, op)) == NULL)
+	return NULL;
+    if (Result == Py_NotImplemented) {
+	Py_DECREF(Result);
+	PyErr_Format(PyExc_TypeError,
+		     "unsupported operand type(s) for %s=: '%s' and '%s'",
+		     CgVar_opstr[op], Py_TYPE(a)->tp_name, Py_TYPE(b)->tp_name);
+	return NULL;
+    }
+    if (cv_type_get(((CgVar *)Result)->cv) == cv_type_get(self->cv))
+	ret = CgVar_value_copy(self, ((CgVar *)Result)->cv) < 0 ? NULL : a;
+    else if ((Str = PyObject_Str(Result)) == NULL)
+	ret = NULL;
+    else {
+	ret = PyObject_CallMethod(a, "_parse", "O", Str);
+	Py_DECREF(Str);
+	Py_XDECREF(ret);
+	ret = ret ? a : NULL;
+    }
+    Py_DECREF(Result);
+    Py_XINCREF(ret);
+
+    return ret;
+}
+
+static PyObject *
+CgVar_iadd(PyObject *a, PyObject *b)
+{
+    return CgVar_inplace(a, b, CGV_OP_ADD);
+}
+
+static PyObject *
+CgVar_isub(PyObject *a, PyObject *b)
+{
+    return CgVar_inplace(a, b, CGV_OP_SUB);
+}
+
+static PyObject *
+CgVar_imul(PyObject *a, PyObject *b)
+{
+    return CgVar_inplace(a, b, CGV_OP_MUL);
+}
+
+static PyObject *
+CgVar_itruediv(PyObject *a, PyObject *b)
+{
+    return CgVar_inplace(a, b, CGV_OP_DIV);
+}
+
+static PyObject *
+CgVar_int(CgVar *self)
+{
+    PyObject *Num;
+    PyObject *Int;
+
+    if ((Num = CgVar_number(self->cv)) == NULL)
+	return NULL;
+    if (PyLong_Check(Num))
+	return Num;
+    Int = PyNumber_Long(Num);
+    Py_DECREF(Num);
+
+    return Int;
+}
+
+static PyObject *
+CgVar_float(CgVar *self)
+{
+    PyObject *Num;
+    PyObject *Float;
+
+    if ((Num = CgVar_number(self->cv)) == NULL)
+	return NULL;
+    if (PyFloat_Check(Num))
+	return Num;
+    Float = PyNumber_Float(Num);
+    Py_DECREF(Num);
+
+    return Float;
+}
+
+static PyNumberMethods CgVar_as_number = {
+    .nb_add = CgVar_add,
+    .nb_subtract = CgVar_sub,
+    .nb_multiply = CgVar_mul,
+    .nb_true_divide = CgVar_truediv,
+    .nb_inplace_add = CgVar_iadd,
+    .nb_inplace_subtract = CgVar_isub,
+    .nb_inplace_multiply = CgVar_imul,
+    .nb_inplace_true_divide = CgVar_itruediv,
+    .nb_int = (unaryfunc)CgVar_int,
+    .nb_float = (unaryfunc)CgVar_float,
+};
+
+/*
+ * Rich comparison with another CgVar, based on cv_cmp()
+ */
+static PyObject *
+CgVar_richcompare(PyObject *a, PyObject *b, int op)
+{
+    int c;
+    int ret;
+
+    if (!PyObject_TypeCheck(a, &CgVar_Type) || 
+	!PyObject_TypeCheck(b, &CgVar_Type))
+	Py_RETURN_NOTIMPLEMENTED;
+
+    c = cv_cmp(((CgVar *)a)->cv, ((CgVar *)b)->cv);
+    switch (op) {
+    case Py_EQ: ret = (c == 0); break;
+    case Py_NE: ret = (c != 0); break;
+    case Py_LT: ret = (c < 0); break;
+    case Py_LE: ret = (c <= 0); break;
+    case Py_GT: ret = (c > 0); break;
+    default:    ret = (c >= 0); break;
+    }
+    if (ret)
+	Py_RETURN_TRUE;
+    Py_RETURN_FALSE;
+}
+
+/*
+ * FNV-1a hashing of the binary value, consistent with cv_cmp() equality.
+ * The name is not part of the hash as it is not compared either.
+ */
+#define FNV_OFFSET  14695981039346656037ULL
+#define FNV_PRIME   1099511628211ULL
+
+static uint64_t
+CgVar_fnv(uint64_t h, const void *data, size_t len)
+{
+    const unsigned char *p = data;
+
+    while (len--) {
+	h ^= *p++;
+	h *= FNV_PRIME;
+    }
+
+    return h;
+}
+
+static Py_hash_t
+CgVar_hash(CgVar *self)
+{
+    int64_t i;
+    uint64_t u;
+    char *str;
+    struct timeval t;
+    uint64_t h = FNV_OFFSET;
+    enum cv_type type = cv_type_get(self->cv);
+
+    h = CgVar_fnv(h, &type, sizeof(type));
+    if (CgVar_int64(self->cv, &i) == 0)
+	h = CgVar_fnv(h, &i, sizeof(i));
+    else switch (type) {
+    case CGV_UINT64:
+	u = cv_uint64_get(self->cv);
+	h = CgVar_fnv(h, &u, sizeof(u));
+	break;
+    case CGV_DEC64:
+	i = cv_dec64_i_get(self->cv);
+	h = CgVar_fnv(h, &i, sizeof(i));
+	break;
+    case CGV_BOOL:
+	i = cv_bool_get(self->cv) ? 1 : 0;
+	h = CgVar_fnv(h, &i, sizeof(i));
+	break;
+    case CGV_STRING:
+    case CGV_REST:
+    case CGV_INTERFACE:
+	if ((str = cv_string_get(self->cv)) != NULL)
+	    h = CgVar_fnv(h, str, strlen(str));
+	break;
+    case CGV_IPV4ADDR:
+    case CGV_IPV4PFX:
+	h = CgVar_fnv(h, cv_ipv4addr_get(self->cv), sizeof(struct in_addr));
+	break;
+    case CGV_IPV6ADDR:
+    case CGV_IPV6PFX:
+	h = CgVar_fnv(h, cv_ipv6addr_get(self->cv), sizeof(struct in6_addr));
+	break;
+    case CGV_MACADDR:
+	h = CgVar_fnv(h, cv_mac_get(self->cv), 6);
+	break;
+    case CGV_UUID:
+	h = CgVar_fnv(h, cv_uuid_get(self->cv), 16);
+	break;
+    case CGV_TIME:
+	t = cv_time_get(self->cv);
+	h = CgVar_fnv(h, &t.tv_sec, sizeof(t.tv_sec));
+	h = CgVar_fnv(h, &t.tv_usec, sizeof(t.tv_usec));
+	break;
+    default:
+	if ((str = cv2str_dup(self->cv)) == NULL) {
+	    PyErr_NoMemory();
+	    return -1;
+	}
+	h = CgVar_fnv(h, str, strlen(str));
+	free(str);
+	break;
+    }
+
+    if ((Py_hash_t)h == -1)
+	return -2;
+    return (Py_hash_t)h;
+}
+
+
+/*
+ * Value accessor.
+ *
+ * The 'value' property maps the cg_var to and from the natural Python object
+ * for its type with a single switch on the type:
+ *
+ *   int8 .. uint64        int
+ *   decimal64             float
+ *   bool                  bool
+ *   string, rest,
+ *   interface, url        str
+ *   ipv4addr, ipv6addr    ipaddress.IPv4Address, ipaddress.IPv6Address
+ *   ipv4prefix,
+ *   ipv6prefix            ipaddress.IPv4Interface, ipaddress.IPv6Interface
+ *   macaddr               int
+ *   uuid                  uuid.UUID
+ *   time                  float, seconds since the epoch
+ *
+ * Any other type reads as None. Values that cannot be assigned directly are
+ * converted with str() and parsed by CLIgen.
+ */
+static PyObject *
+CgVar_value_get(CgVar *self, void *closure)
+{
+    char *str;
+    PyObject *Class;
+    struct in_addr *addr;
+    struct in6_addr *addr6;
+
+    switch (cv_type_get(self->cv)) {
+    case CGV_INT8:
+    case CGV_INT16:
+    case CGV_INT32:
+    case CGV_INT64:
+    case CGV_UINT8:
+    case CGV_UINT16:
+    case CGV_UINT32:
+    case CGV_UINT64:
+    case CGV_DEC64:
+	return CgVar_number(self->cv);
+
+    case CGV_BOOL:
+	return PyBool_FromLong(cv_bool_get(self->cv));
+
+    case CGV_STRING:
+    case CGV_REST:
+    case CGV_INTERFACE:
+	if ((str = cv_string_get(self->cv)) == NULL)
+	    Py_RETURN_NONE;
+	return StringFromString(str);
+
+    case CGV_URL:
+	return CgVar_repr((PyObject *)self);
+
+    case CGV_IPV4ADDR:
+	return _CgVar_ipv4addr_get(self);
+
+    case CGV_IPV4PFX:
+	Class = CgVar_class(&IPv4Interface_Class, "ipaddress", "IPv4Interface");
+	if ((addr = cv_ipv4addr_get(self->cv)) == NULL)
+	    Py_RETURN_NONE;
+	return CgVar_ipaddress(Class, addr, sizeof(*addr),
+			       cv_ipv4masklen_get(self->cv));
+
+    case CGV_IPV6ADDR:
+	return _CgVar_ipv6addr_get(self);
+
+    case CGV_IPV6PFX:
+	Class = CgVar_class(&IPv6Interface_Class, "ipaddress", "IPv6Interface");
+	if ((addr6 = cv_ipv6addr_get(self->cv)) == NULL)
+	    Py_RETURN_NONE;
+	return CgVar_ipaddress(Class, addr6, sizeof(*addr6),
+			       cv_ipv6masklen_get(self->cv));
+
+    case CGV_MACADDR:
+	return _CgVar_mac_get(self);
+
+    case CGV_UUID:
+	return _CgVar_uuid_get(self);
+
+    case CGV_TIME:
+	return _CgVar_time_get(self);
+
+    default:
+	Py_RETURN_NONE;
+    }
+}
+
+/*
+ * Call one of the binary setters with Val as argument
+ */
+static int
+CgVar_value_call(CgVar *self, PyObject *(*fn)(CgVar *, PyObject *),
+		 PyObject *Val)
+{
+    PyObject *Args;
+    PyObject *ret;
+
+    if ((Args = PyTuple_Pack(1, Val)) == NULL)
+	return -1;
+    ret = fn(self, Args);
+    Py_DECREF(Args);
+    if (ret == NULL)
+	return -1;
+    Py_DECREF(ret);
+
+    return 0;
+}
+
+/*
+ * Set the address and mask length of a prefix variable from an
+ * ipaddress.IPv4Interface or ipaddress.IPv6Interface object.
+ */
+static int
+CgVar_interface_set(CgVar *self, PyObject *Val,
+		    PyObject *(*addr_set)(CgVar *, PyObject *),
+		    PyObject *(*masklen_set)(CgVar *, PyObject *))
+{
+    int ret;
+    PyObject *Network;
+    PyObject *Masklen;
+
+    if ((Network = PyObject_GetAttrString(Val, "network")) == NULL)
+	return -1;
+    Masklen = PyObject_GetAttrString(Network, "prefixlen");
+    Py_DECREF(Network);
+    if (Masklen == NULL)
+	return -1;
+    if ((ret = CgVar_value_call(self, addr_set, Val)) == 0)
+	ret = CgVar_value_call(self, masklen_set, Masklen);
+    Py_DECREF(Masklen);
+
+    return ret;
+}
+
+static int
+CgVar_value_set(CgVar *self, PyObject *Val, void *closure)
+{
+    int i;
+    char *str;
+    PyObject *Class;
+    PyObject *Str;
+    PyObject *ret;
+    enum cv_type type = cv_type_get(self->cv);
+
+    if (Val == NULL) {
+	PyErr_SetString(PyExc_AttributeError, "cannot delete value");
+	return -1;
+    }
+
+    if (CgVar_type_isnumeric(type) && 
+	(PyLong_Check(Val) || PyFloat_Check(Val)))
+	return CgVar_number_set(self->cv, Val);
+
+    switch (type) {
+    case CGV_BOOL:
+	/* Strings such as "false" are parsed below */
+	if (!PyLong_Check(Val))
+	    break;
+	if ((i = PyObject_IsTrue(Val)) < 0)
+	    return -1;
+	cv_bool_set(self->cv, i);
+	return 0;
+
+    case CGV_STRING:
+    case CGV_REST:
+    case CGV_INTERFACE:
+	if (!PyUnicode_Check(Val))
+	    break;
+	if ((str = (char *)PyUnicode_AsUTF8(Val)) == NULL)
+	    return -1;
+	if (cv_string_set(self->cv, str) == NULL) {
+	    PyErr_NoMemory();
+	    return -1;
+	}
+	return 0;
+
+    case CGV_IPV4ADDR:
+	Class = CgVar_class(&IPv4Address_Class, "ipaddress", "IPv4Address");
+	if (PyLong_Check(Val) || PyBytes_Check(Val) ||
+	    (Class && PyObject_IsInstance(Val, Class) == 1))
+	    return CgVar_value_call(self, _CgVar_ipv4addr_set, Val);
+	break;
+
+    case CGV_IPV4PFX:
+	Class = CgVar_class(&IPv4Interface_Class, "ipaddress", "IPv4Interface");
+	if (Class && PyObject_IsInstance(Val, Class) == 1)
+	    return CgVar_interface_set(self, Val, _CgVar_ipv4addr_set,
+				       _CgVar_ipv4masklen_set);
+	break;
+
+    case CGV_IPV6ADDR:
+	Class = CgVar_class(&IPv6Address_Class, "ipaddress", "IPv6Address");
+	if (PyLong_Check(Val) || PyBytes_Check(Val) ||
+	    (Class && PyObject_IsInstance(Val, Class) == 1))
+	    return CgVar_value_call(self, _CgVar_ipv6addr_set, Val);
+	break;
+
+    case CGV_IPV6PFX:
+	Class = CgVar_class(&IPv6Interface_Class, "ipaddress", "IPv6Interface");
+	if (Class && PyObject_IsInstance(Val, Class) == 1)
+	    return CgVar_interface_set(self, Val, _CgVar_ipv6addr_set,
+				       _CgVar_ipv6masklen_set);
+	break;
+
+    case CGV_MACADDR:
+	if (PyLong_Check(Val))
+	    return CgVar_value_call(self, _CgVar_mac_set, Val);
+	break;
+
+    case CGV_UUID:
+	Class = CgVar_class(&UUID_Class, "uuid", "UUID");
+	if (PyBytes_Check(Val) || (Class && PyObject_IsInstance(Val, Class) == 1))
+	    return CgVar_value_call(self, _CgVar_uuid_set, Val);
+	break;
+
+    case CGV_TIME:
+	if (PyLong_Check(Val) || PyFloat_Check(Val))
+	    return CgVar_value_call(self, _CgVar_time_set, Val);
+	break;
+
+    default:
+	break;
+    }
+    if (PyErr_Occurred())
+	return -1;
+
+    if ((Str = PyObject_Str(Val)) == NULL)
+	return -1;
+    ret = PyObject_CallMethod((PyObject *)self, "_parse", "O", Str);
+    Py_DECREF(Str);
+    if (ret == NULL)
+	return -1;
+    Py_DECREF(ret);
+
+    return 0;
+}
+
+static PyObject *
+CgVar_isnumeric(CgVar *self)
+{
+    return PyBool_FromLong(CgVar_type_isnumeric(cv_type_get(self->cv)));
+}
+
+static PyObject *
+CgVar_isstring(CgVar *self)
+{
+    return PyBool_FromLong(CgVar_type_isstring(cv_type_get(self->cv)));
+}
+
+static PyObject *
+CgVar_encode_method(CgVar *self)
+{
+    PyObject *Seq;
+    PyObject *ret;
+
+    if ((Seq = PyTuple_Pack(1, (PyObject *)self)) == NULL)
+	return NULL;
+    ret = Cvec_encode_seq(Seq, 0);
+    Py_DECREF(Seq);
+
+    return ret;
+}
+
+/*
+ * Pickle as cligen.decode(self.encode())
+ */
+static PyObject *
+CgVar_reduce(CgVar *self)
+{
+    PyObject *Decode;
+
+    if ((Decode = PyObject_GetAttrString(__cligen_module(), "decode")) == NULL)
+	return NULL;
+
+    return Py_BuildValue("(N(N))", Decode, CgVar_encode_method(self));
+}
+
+static PyGetSetDef CgVar_getset[] = {
+    {"value", (getter)CgVar_value_get, (setter)CgVar_value_set,
+     "The value of the variable as a Python object of the natural type", 
+     NULL},
+    {NULL}  /* Sentinel */
+};
+
+
+/*
+ * Internal method: Get cg_var* pointer to self->cv. 
+ */
+static PyObject *
+__CgVar_cv(CgVar *self)
+{
+    PyObject *Cv;
+
+    if ((Cv = PyCapsule_New((void *)self->cv, NULL, NULL)) == NULL)
+	return NULL;
+
+    return Cv;
+}
+
+
+static PyMethodDef CgVar_methods[] = {
+    {"_name_get", (PyCFunction)_CgVar_name_get, METH_NOARGS,
+    "Return the name of the variable"
     },
     {"_name_set", (PyCFunction)_CgVar_name_set, METH_VARARGS,
     "Set the name of the variable"
@@ -1048,11 +2369,12 @@ static PyMethodDef CgVar_methods[] = {
     {"_ipv4masklen_get", (PyCFunction)_CgVar_ipv4masklen_get, METH_NOARGS, 
      "Return the IPv4 prefix masklen of the variable"
     },
-#if notimplemented
     {"_ipv4addr_set", (PyCFunction)_CgVar_ipv4addr_set, METH_VARARGS, 
      "Set the IPv4 address value of the variable"
     },
-#endif
+    {"_ipv4masklen_set", (PyCFunction)_CgVar_ipv4masklen_set, METH_VARARGS, 
+     "Set the IPv4 prefix masklen of the variable"
+    },
 
     {"_ipv6addr_get", (PyCFunction)_CgVar_ipv6addr_get, METH_NOARGS, 
      "Return the Ipv6 address value of the variable"
@@ -1061,19 +2383,26 @@ static PyMethodDef CgVar_methods[] = {
     {"_ipv6masklen_get", (PyCFunction)_CgVar_ipv6masklen_get, METH_NOARGS, 
      "Return the Ipv6 prefix masklen of the variable"
     },
-#if notimplemented
     {"_ipv6addr_set", (PyCFunction)_CgVar_ipv6addr_set, METH_VARARGS, 
      "Set the Ipv6 address value of the variable"
     },
-#endif
+    {"_ipv6masklen_set", (PyCFunction)_CgVar_ipv6masklen_set, METH_VARARGS, 
+     "Set the Ipv6 prefix masklen of the variable"
+    },
 
     {"_mac_get", (PyCFunction)_CgVar_mac_get, METH_NOARGS, 
      "Get the MAC address value of the variable"
     },
+    {"_mac_set", (PyCFunction)_CgVar_mac_set, METH_VARARGS, 
+     "Set the MAC address value of the variable"
+    },
 
     {"_uuid_get", (PyCFunction)_CgVar_uuid_get, METH_NOARGS, 
      "Get the UUID value of the variable"
     },
+    {"_uuid_set", (PyCFunction)_CgVar_uuid_set, METH_VARARGS, 
+     "Set the UUID value of the variable"
+    },
 
     {"_time_get", (PyCFunction)_CgVar_time_get, METH_NOARGS, 
      "Get the time value of the variable"
@@ -1100,6 +2429,19 @@ static PyMethodDef CgVar_methods[] = {
      "Copy CgVar"
     },
 
+    {"isnumeric", (PyCFunction)CgVar_isnumeric, METH_NOARGS, 
+     "Return True if the variable is of a numeric type"
+    },
+    {"isstring", (PyCFunction)CgVar_isstring, METH_NOARGS, 
+     "Return True if the variable is of a string type"
+    },
+    {"encode", (PyCFunction)CgVar_encode_method, METH_NOARGS, 
+     "Encode the variable in the binary wire format"
+    },
+    {"__reduce__", (PyCFunction)CgVar_reduce, METH_NOARGS, 
+     "Pickle support"
+    },
+
     {"__cv", (PyCFunction)__CgVar_cv, METH_NOARGS, 
      "Get a pointer to self->cv"
     },
@@ -1120,10 +2462,10 @@ PyTypeObject CgVar_Type = {
     0,                         /* tp_setattr */
     0,                         /* tp_reserved */
     CgVar_repr,                /* tp_repr */
-    0,                         /* tp_as_number */
+    &CgVar_as_number,          /* tp_as_number */
     0,                         /* tp_as_sequence */
     0,                         /* tp_as_mapping */
-    0,                         /* tp_hash  */
+    (hashfunc)CgVar_hash,      /* tp_hash  */
     0,                         /* tp_call */
     CgVar_repr,                /* tp_str */
     0,                         /* tp_getattro */
@@ -1134,13 +2476,13 @@ PyTypeObject CgVar_Type = {
     "CgVar objects",           /* tp_doc */
     0,                         /* tp_traverse */
     0,                         /* tp_clear */
-    0,                         /* tp_richcompare */
+    CgVar_richcompare,         /* tp_richcompare */
     0,                         /* tp_weaklistoffset */
     0,                         /* tp_iter */
     0,                         /* tp_iternext */
     CgVar_methods,             /* tp_methods */
     0,                         /* tp_members */
-    0,                         /* tp_getset */
+    CgVar_getset,              /* tp_getset */
     0,                         /* tp_base */
     0,                         /* tp_dict */
     0,                         /* tp_descr_get */
@@ -1158,6 +2500,12 @@ CgVar_init_object(PyObject *m)
     if (PyType_Ready(&CgVar_Type) < 0)
         return -1;
 
+    if ((scratch = cv_new(CGV_ERR)) == NULL) {
+	PyErr_SetString(PyExc_MemoryError, "cv_new");
+	return -1;
+    }
+    Mem_track(MEM_CGVAR, scratch, MEM_CGVAR_SIZE);
+
     Py_INCREF(&CgVar_Type);
     PyModule_AddObject(m, "CgVar", (PyObject *)&CgVar_Type);
 
@@ -1191,6 +2539,17 @@ CgVar_init_object(PyObject *m)
     return 0;
 }
 
+/*
+ * Release what CgVar_init_object() allocated, when the module is freed
+ */
+void
+CgVar_fini_object(void)
+{
+    Mem_untrack(MEM_CGVAR, scratch, MEM_CGVAR_SIZE);
+    cv_free(scratch);
+    scratch = NULL;
+}
+
 PyObject *
 CgVar_Instance(cg_var *cv)
 {
@@ -1210,6 +2569,69 @@ CgVar_Instance(cg_var *cv)
     return Cv;
 }    
 
+/*
+ * Get the name of a CgVar object as an interned string, or None if it has
+ * no name. The string is cached in the object. Returns a borrowed reference.
+ */
+PyObject *
+CgVar_name(PyObject *Cv)
+{
+    char *name;
+    CgVar *self = (CgVar *)Cv;
+
+    if (self->name == NULL) {
+	if ((name = cv_name_get(self->cv)) == NULL) {
+	    Py_INCREF(Py_None);
+	    self->name = Py_None;
+	} else if ((self->name = PyUnicode_InternFromString(name)) == NULL)
+	    return NULL;
+    }
+
+    return self->name;
+}
+
+/*
+ * Get the value of a CgVar object as a Python object, see CgVar.value
+ */
+PyObject *
+CgVar_value(PyObject *Cv)
+{
+    return CgVar_value_get((CgVar *)Cv, NULL);
+}
+
+/*
+ * Copy-on-write support for Cvec. A shared CgVar is referenced by the lists
+ * of one or more Cvec objects and by nothing else, see pycligen_cvec.c.
+ */
+int
+CgVar_isshared(PyObject *Cv)
+{
+    return ((CgVar *)Cv)->shared;
+}
+
+void
+CgVar_share(PyObject *Cv)
+{
+    ((CgVar *)Cv)->shared = 1;
+}
+
+/*
+ * Get a private version of a shared CgVar borrowed from a Cvec list: the
+ * CgVar itself if that list is its only reference, else a copy. Returns a
+ * new reference.
+ */
+PyObject *
+CgVar_unshare(PyObject *Cv)
+{
+    if (Py_REFCNT(Cv) == 1) {
+	((CgVar *)Cv)->shared = 0;
+	Py_INCREF(Cv);
+	return Cv;
+    }
+
+    return CgVar_Instance(((CgVar *)Cv)->cv);
+}
+
 /*
  * Get cg_var* pointer from CgVar object
  */
@@ -1223,3 +2645,600 @@ CgVar_cv(PyObject *Cv)
 
     return ((CgVar *)Cv)->cv;
 }
+
+/*
+ * Bulk parsing.
+ *
+ * Parse a sequence of strings as one CLIgen type. Numeric and address types
+ * are parsed with the GIL released into a single scratch cg_var and packed
+ * into an array.array:
+ *
+ *   int8 .. uint64        'b', 'h', 'i', 'q', 'B', 'H', 'I', 'Q'
+ *   decimal64, time       'd'
+ *   bool                  'B'
+ *   macaddr               'Q'
+ *   ipv4addr, ipv4prefix  'I', address in host byte order
+ *   ipv6addr, ipv6prefix,
+ *   uuid                  'B', 16 bytes per item in network byte order
+ *
+ * Prefix types additionally return the mask lengths as an array.array('B').
+ * Other types are returned as a list of CgVar objects. Items failing to parse
+ * are zero (or None) and flagged in the error mask.
+ */
+size_t
+CgVar_pack_size(enum cv_type type, const char **fmt)
+{
+    switch (type) {
+    case CGV_INT8:     *fmt = "b"; return 1;
+    case CGV_INT16:    *fmt = "h"; return 2;
+    case CGV_INT32:    *fmt = "i"; return 4;
+    case CGV_INT64:    *fmt = "q"; return 8;
+    case CGV_UINT8:    *fmt = "B"; return 1;
+    case CGV_UINT16:   *fmt = "H"; return 2;
+    case CGV_UINT32:   *fmt = "I"; return 4;
+    case CGV_UINT64:   *fmt = "Q"; return 8;
+    case CGV_DEC64:    *fmt = "d"; return 8;
+    case CGV_TIME:     *fmt = "d"; return 8;
+    case CGV_BOOL:     *fmt = "B"; return 1;
+    case CGV_MACADDR:  *fmt = "Q"; return 8;
+    case CGV_IPV4ADDR: 
+    case CGV_IPV4PFX:  *fmt = "I"; return 4;
+    case CGV_IPV6ADDR:
+    case CGV_IPV6PFX:
+    case CGV_UUID:     *fmt = "B"; return 16;
+    default:
+	return 0;
+    }
+}
+
+/*
+ * Pack the value of cv into dst and its mask length into masklen. The
+ * size and type code of the packed value is given by CgVar_pack_size().
+ */
+void
+CgVar_pack(cg_var *cv, char *dst, uint8_t *masklen)
+{
+    int n;
+    int8_t i8;
+    int16_t i16;
+    int32_t i32;
+    int64_t i64;
+    uint8_t u8;
+    uint16_t u16;
+    uint32_t u32;
+    uint64_t u64;
+    double d;
+    unsigned char *m;
+    struct timeval t;
+
+    switch (cv_type_get(cv)) {
+    case CGV_INT8:   i8 = cv_int8_get(cv); memcpy(dst, &i8, 1); break;
+    case CGV_INT16:  i16 = cv_int16_get(cv); memcpy(dst, &i16, 2); break;
+    case CGV_INT32:  i32 = cv_int32_get(cv); memcpy(dst, &i32, 4); break;
+    case CGV_INT64:  i64 = cv_int64_get(cv); memcpy(dst, &i64, 8); break;
+    case CGV_UINT8:  u8 = cv_uint8_get(cv); memcpy(dst, &u8, 1); break;
+    case CGV_UINT16: u16 = cv_uint16_get(cv); memcpy(dst, &u16, 2); break;
+    case CGV_UINT32: u32 = cv_uint32_get(cv); memcpy(dst, &u32, 4); break;
+    case CGV_UINT64: u64 = cv_uint64_get(cv); memcpy(dst, &u64, 8); break;
+    case CGV_BOOL:   u8 = cv_bool_get(cv) ? 1 : 0; memcpy(dst, &u8, 1); break;
+    case CGV_DEC64:
+	d = cv_dec64_i_get(cv);
+	for (n = cv_dec64_n_get(cv); n > 0; n--)
+	    d /= 10;
+	memcpy(dst, &d, 8);
+	break;
+    case CGV_TIME:
+	t = cv_time_get(cv);
+	d = t.tv_sec + t.tv_usec / 1000000.0;
+	memcpy(dst, &d, 8);
+	break;
+    case CGV_MACADDR:
+	m = (unsigned char *)cv_mac_get(cv);
+	u64 = ((uint64_t)m[0] << 40) | ((uint64_t)m[1] << 32) |
+	    ((uint64_t)m[2] << 24) | ((uint64_t)m[3] << 16) |
+	    ((uint64_t)m[4] << 8) | m[5];
+	memcpy(dst, &u64, 8);
+	break;
+    case CGV_IPV4ADDR:
+    case CGV_IPV4PFX:
+	u32 = ntohl(cv_ipv4addr_get(cv)->s_addr);
+	memcpy(dst, &u32, 4);
+	*masklen = cv_ipv4masklen_get(cv);
+	break;
+    case CGV_IPV6ADDR:
+    case CGV_IPV6PFX:
+	memcpy(dst, cv_ipv6addr_get(cv), 16);
+	*masklen = cv_ipv6masklen_get(cv);
+	break;
+    case CGV_UUID:
+	memcpy(dst, cv_uuid_get(cv), 16);
+	break;
+    default:
+	break;
+    }
+}
+
+/*
+ * Parse str into cv, applying the same fixups as CgVar._parse(). Returns 1
+ * if parsed successfully, 0 if not. Safe to call without the GIL.
+ */
+static int
+CgVar_bulk_parse1(cg_var *cv, const char *str)
+{
+    int ret;
+    char *dot;
+    char *reason = NULL;
+    char buf[8];
+
+    switch (cv_type_get(cv)) {
+    case CGV_BOOL:  /* CLIgen wants lowercase */
+	if (strlen(str) < sizeof(buf)) {
+	    strcpy(buf, str);
+	    buf[0] = tolower(buf[0]);
+	    str = buf;
+	}
+	break;
+    case CGV_DEC64:
+	dot = strrchr(str, '.');
+	cv_dec64_n_set(cv, (dot ? strlen(dot+1) : 1));
+	break;
+    default:
+	break;
+    }
+
+    ret = cv_parse1((char *)str, cv, &reason);
+    free(reason);
+
+    return (ret > 0);
+}
+
+static PyObject *Array_Class = NULL;
+
+/*
+ * Create an array.array of type code fmt from the bytes in Buf
+ */
+static PyObject *
+CgVar_array(const char *fmt, PyObject *Buf)
+{
+    PyObject *Class;
+
+    if ((Class = CgVar_class(&Array_Class, "array", "array")) == NULL)
+	return NULL;
+
+    return PyObject_CallFunction(Class, "sO", fmt, Buf);
+}
+
+PyObject *
+CgVar_parse_bulk(PyObject *self, PyObject *args)
+{
+    int type;
+    size_t i;
+    size_t n;
+    size_t size;
+    const char *fmt = NULL;
+    const char **strs = NULL;
+    char *vals;
+    char *errs;
+    uint8_t *masklens;
+    cg_var *cv = NULL;
+    PyObject *Seq;
+    PyObject *Tuple = NULL;
+    PyObject *Keep = NULL;
+    PyObject *Item;
+    PyObject *Str;
+    PyObject *Vals = NULL;
+    PyObject *Errs = NULL;
+    PyObject *Masklens = NULL;
+    PyObject *Cv;
+    PyObject *Array;
+    PyObject *ret = NULL;
+
+    if (!PyArg_ParseTuple(args, "iO", &type, &Seq))
+        return NULL;
+
+    /*
+     * Parse a snapshot, the strings are used without the GIL and another
+     * thread could otherwise free them by changing a list passed in.
+     */
+    if ((Tuple = PySequence_Tuple(Seq)) == NULL)
+	return NULL;
+    n = PyTuple_GET_SIZE(Tuple);
+    if ((Errs = PyByteArray_FromStringAndSize(NULL, n)) == NULL)
+	goto done;
+    errs = PyByteArray_AS_STRING(Errs);
+    memset(errs, 0, n);
+
+    /* Get C strings of all items, converting non-strings with str() */
+    if ((strs = malloc((n ? n : 1) * sizeof(char *))) == NULL) {
+	PyErr_NoMemory();
+	goto done;
+    }
+    if ((Keep = PyList_New(0)) == NULL)
+	goto done;
+    for (i = 0; i < n; i++) {
+	Item = PyTuple_GET_ITEM(Tuple, i);
+	if (PyBytes_Check(Item)) {
+	    strs[i] = PyBytes_AS_STRING(Item);
+	    continue;
+	}
+	if (PyUnicode_Check(Item))
+	    Str = Item;
+	else {
+	    if ((Str = PyObject_Str(Item)) == NULL)
+		goto done;
+	    if (PyList_Append(Keep, Str) < 0) {
+		Py_DECREF(Str);
+		goto done;
+	    }
+	    Py_DECREF(Str);
+	}
+	if ((strs[i] = PyUnicode_AsUTF8(Str)) == NULL)
+	    goto done;
+    }
+
+    /* Types not packable into an array are returned as CgVar objects */
+    if ((size = CgVar_pack_size(type, &fmt)) == 0) {
+	if ((Vals = PyList_New(n)) == NULL)
+	    goto done;
+	for (i = 0; i < n; i++) {
+	    if ((Cv = CgVar_Instance(NULL)) == NULL)
+		goto done;
+	    cv_type_set(((CgVar *)Cv)->cv, type);
+	    if (!CgVar_bulk_parse1(((CgVar *)Cv)->cv, strs[i])) {
+		errs[i] = 1;
+		Py_DECREF(Cv);
+		Py_INCREF(Py_None);
+		Cv = Py_None;
+	    }
+	    PyList_SET_ITEM(Vals, i, Cv);
+	}
+	ret = Py_BuildValue("(OO)", Vals, Errs);
+	goto done;
+    }
+
+    if ((cv = cv_new(type)) == NULL) {
+	PyErr_SetString(PyExc_MemoryError, "cv_new");
+	goto done;
+    }
+    if ((Vals = PyByteArray_FromStringAndSize(NULL, n * size)) == NULL ||
+	(Masklens = PyByteArray_FromStringAndSize(NULL, n)) == NULL)
+	goto done;
+    vals = PyByteArray_AS_STRING(Vals);
+    masklens = (uint8_t *)PyByteArray_AS_STRING(Masklens);
+    memset(vals, 0, n * size);
+    memset(masklens, 0, n);
+
+    Py_BEGIN_ALLOW_THREADS
+    for (i = 0; i < n; i++) {
+	if (CgVar_bulk_parse1(cv, strs[i]))
+	    CgVar_pack(cv, vals + i * size, &masklens[i]);
+	else
+	    errs[i] = 1;
+    }
+    Py_END_ALLOW_THREADS
+
+    if ((Array = CgVar_array(fmt, Vals)) == NULL)
+	goto done;
+    if (type == CGV_IPV4PFX || type == CGV_IPV6PFX) {
+	if ((Cv = CgVar_array("B", Masklens)) == NULL) {
+	    Py_DECREF(Array);
+	    goto done;
+	}
+	ret = Py_BuildValue("((NN)O)", Array, Cv, Errs);
+    } else
+	ret = Py_BuildValue("(NO)", Array, Errs);
+
+done:
+    if (cv)
+	cv_free(cv);
+    free(strs);
+    Py_XDECREF(Tuple);
+    Py_XDECREF(Keep);
+    Py_XDECREF(Vals);
+    Py_XDECREF(Errs);
+    Py_XDECREF(Masklens);
+    return ret;
+}
+
+/*
+ * Binary encoding of values, used by the wire format described in
+ * pycligen_cvec.c. Values are encoded little-endian:
+ *
+ *   int8 .. uint64         1, 2, 4 or 8 bytes
+ *   decimal64              n (1 byte), i (8 bytes)
+ *   bool                   1 byte
+ *   string, rest,
+ *   interface, url         UTF-8 string, not terminated
+ *   ipv4addr, ipv4prefix   address (4 bytes, network order), masklen (1 byte)
+ *   ipv6addr, ipv6prefix   address (16 bytes, network order), masklen (1 byte)
+ *   macaddr                6 bytes
+ *   uuid                   16 bytes
+ *   time                   seconds (8 bytes), microseconds (4 bytes)
+ *
+ * Other types have no value.
+ */
+static void
+CgVar_put(char *p, uint64_t val, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++, val >>= 8)
+	p[i] = val & 0xff;
+}
+
+static uint64_t
+CgVar_get(const char *p, int len)
+{
+    int i;
+    uint64_t val = 0;
+
+    for (i = len - 1; i >= 0; i--)
+	val = (val << 8) | (unsigned char)p[i];
+
+    return val;
+}
+
+/*
+ * Get the length of the encoded value of a CgVar object
+ */
+Py_ssize_t
+CgVar_encode_len(PyObject *Cv)
+{
+    char *str;
+    Py_ssize_t len;
+    cg_var *cv = ((CgVar *)Cv)->cv;
+
+    switch (cv_type_get(cv)) {
+    case CGV_INT8:
+    case CGV_UINT8:
+    case CGV_BOOL:     return 1;
+    case CGV_INT16:
+    case CGV_UINT16:   return 2;
+    case CGV_INT32:
+    case CGV_UINT32:   return 4;
+    case CGV_INT64:
+    case CGV_UINT64:   return 8;
+    case CGV_DEC64:    return 9;
+    case CGV_IPV4ADDR:
+    case CGV_IPV4PFX:  return 5;
+    case CGV_IPV6ADDR:
+    case CGV_IPV6PFX:  return 17;
+    case CGV_MACADDR:  return 6;
+    case CGV_UUID:     return 16;
+    case CGV_TIME:     return 12;
+    case CGV_STRING:
+    case CGV_REST:
+    case CGV_INTERFACE:
+	return (str = cv_string_get(cv)) ? strlen(str) : 0;
+    case CGV_URL:
+	if ((str = cv2str_dup(cv)) == NULL) {
+	    PyErr_NoMemory();
+	    return -1;
+	}
+	len = strlen(str);
+	free(str);
+	return len;
+    default:
+	return 0;
+    }
+}
+
+/*
+ * Encode the value of a CgVar object into p, which must have room for
+ * CgVar_encode_len() bytes.
+ */
+int
+CgVar_encode(PyObject *Cv, char *p)
+{
+    char *str;
+    struct timeval t;
+    cg_var *cv = ((CgVar *)Cv)->cv;
+
+    switch (cv_type_get(cv)) {
+    case CGV_INT8:   CgVar_put(p, (uint8_t)cv_int8_get(cv), 1); break;
+    case CGV_INT16:  CgVar_put(p, (uint16_t)cv_int16_get(cv), 2); break;
+    case CGV_INT32:  CgVar_put(p, (uint32_t)cv_int32_get(cv), 4); break;
+    case CGV_INT64:  CgVar_put(p, (uint64_t)cv_int64_get(cv), 8); break;
+    case CGV_UINT8:  CgVar_put(p, cv_uint8_get(cv), 1); break;
+    case CGV_UINT16: CgVar_put(p, cv_uint16_get(cv), 2); break;
+    case CGV_UINT32: CgVar_put(p, cv_uint32_get(cv), 4); break;
+    case CGV_UINT64: CgVar_put(p, cv_uint64_get(cv), 8); break;
+    case CGV_BOOL:   CgVar_put(p, cv_bool_get(cv) ? 1 : 0, 1); break;
+    case CGV_DEC64:
+	CgVar_put(p, cv_dec64_n_get(cv), 1);
+	CgVar_put(p + 1, (uint64_t)cv_dec64_i_get(cv), 8);
+	break;
+    case CGV_IPV4ADDR:
+    case CGV_IPV4PFX:
+	memcpy(p, cv_ipv4addr_get(cv), 4);
+	CgVar_put(p + 4, cv_ipv4masklen_get(cv), 1);
+	break;
+    case CGV_IPV6ADDR:
+    case CGV_IPV6PFX:
+	memcpy(p, cv_ipv6addr_get(cv), 16);
+	CgVar_put(p + 16, cv_ipv6masklen_get(cv), 1);
+	break;
+    case CGV_MACADDR:
+	memcpy(p, cv_mac_get(cv), 6);
+	break;
+    case CGV_UUID:
+	memcpy(p, cv_uuid_get(cv), 16);
+	break;
+    case CGV_TIME:
+	t = cv_time_get(cv);
+	CgVar_put(p, (uint64_t)t.tv_sec, 8);
+	CgVar_put(p + 8, (uint32_t)t.tv_usec, 4);
+	break;
+    case CGV_STRING:
+    case CGV_REST:
+    case CGV_INTERFACE:
+	if ((str = cv_string_get(cv)) != NULL)
+	    memcpy(p, str, strlen(str));
+	break;
+    case CGV_URL:
+	if ((str = cv2str_dup(cv)) == NULL) {
+	    PyErr_NoMemory();
+	    return -1;
+	}
+	memcpy(p, str, strlen(str));
+	free(str);
+	break;
+    default:
+	break;
+    }
+
+    return 0;
+}
+
+/*
+ * Check if a type is one CgVar_encode() knows. CGV_ERR and CGV_VOID carry
+ * no value and encode as zero bytes.
+ */
+static int
+CgVar_type_encodable(int type)
+{
+    switch (type) {
+    case CGV_ERR:
+    case CGV_INT8:
+    case CGV_INT16:
+    case CGV_INT32:
+    case CGV_INT64:
+    case CGV_UINT8:
+    case CGV_UINT16:
+    case CGV_UINT32:
+    case CGV_UINT64:
+    case CGV_DEC64:
+    case CGV_BOOL:
+    case CGV_REST:
+    case CGV_STRING:
+    case CGV_INTERFACE:
+    case CGV_IPV4ADDR:
+    case CGV_IPV4PFX:
+    case CGV_IPV6ADDR:
+    case CGV_IPV6PFX:
+    case CGV_MACADDR:
+    case CGV_URL:
+    case CGV_UUID:
+    case CGV_TIME:
+    case CGV_VOID:
+	return 1;
+    default:
+	return 0;
+    }
+}
+
+/*
+ * Create a CgVar object from an encoded value. Name is an interned string
+ * or None. String values may not contain NUL bytes, as cligen stores them
+ * as C strings. Returns a new reference.
+ */
+PyObject *
+CgVar_decode(int type, PyObject *Name, int cnst, int flag,
+	     const char *p, Py_ssize_t len)
+{
+    int ret;
+    char *str;
+    CgVar *Cv;
+    cg_var *cv;
+    struct timeval t;
+    PyObject *Tmp;
+
+    if (!CgVar_type_encodable(type)) {
+	PyErr_Format(PyExc_ValueError, "invalid encoded type %d", type);
+	return NULL;
+    }
+    if ((Cv = (CgVar *)CgVar_Instance(NULL)) == NULL)
+	return NULL;
+    cv = Cv->cv;
+    cv_type_set(cv, type);
+    if (Name != Py_None) {
+	if ((str = (char *)PyUnicode_AsUTF8(Name)) == NULL)
+	    goto fail;
+	if (cv_name_set(cv, str) == NULL) {
+	    PyErr_NoMemory();
+	    goto fail;
+	}
+    }
+    Py_INCREF(Name);
+    Cv->name = Name;
+    cv_const_set(cv, cnst);
+    cv_flag_set(cv, flag);
+
+    if (!CgVar_type_isstring(type) && type != CGV_URL &&
+	len != CgVar_encode_len((PyObject *)Cv))
+	goto invalid;
+    if (CgVar_type_isstring(type) && memchr(p, '\0', len) != NULL)
+	goto invalid;
+
+    switch (type) {
+    case CGV_INT8:   cv_int8_set(cv, (int8_t)CgVar_get(p, 1)); break;
+    case CGV_INT16:  cv_int16_set(cv, (int16_t)CgVar_get(p, 2)); break;
+    case CGV_INT32:  cv_int32_set(cv, (int32_t)CgVar_get(p, 4)); break;
+    case CGV_INT64:  cv_int64_set(cv, (int64_t)CgVar_get(p, 8)); break;
+    case CGV_UINT8:  cv_uint8_set(cv, CgVar_get(p, 1)); break;
+    case CGV_UINT16: cv_uint16_set(cv, CgVar_get(p, 2)); break;
+    case CGV_UINT32: cv_uint32_set(cv, CgVar_get(p, 4)); break;
+    case CGV_UINT64: cv_uint64_set(cv, CgVar_get(p, 8)); break;
+    case CGV_BOOL:   cv_bool_set(cv, CgVar_get(p, 1) ? 1 : 0); break;
+    case CGV_DEC64:
+	cv_dec64_n_set(cv, CgVar_get(p, 1));
+	cv_dec64_i_set(cv, (int64_t)CgVar_get(p + 1, 8));
+	break;
+    case CGV_IPV4ADDR:
+    case CGV_IPV4PFX:
+	if (CgVar_get(p + 4, 1) > 32)
+	    goto invalid;
+	memcpy(cv_ipv4addr_get(cv), p, 4);
+	cv_ipv4masklen_set(cv, CgVar_get(p + 4, 1));
+	break;
+    case CGV_IPV6ADDR:
+    case CGV_IPV6PFX:
+	if (CgVar_get(p + 16, 1) > 128)
+	    goto invalid;
+	memcpy(cv_ipv6addr_get(cv), p, 16);
+	cv_ipv6masklen_set(cv, CgVar_get(p + 16, 1));
+	break;
+    case CGV_MACADDR:
+	memcpy(cv_mac_get(cv), p, 6);
+	break;
+    case CGV_UUID:
+	memcpy(cv_uuid_get(cv), p, 16);
+	break;
+    case CGV_TIME:
+	t.tv_sec = (time_t)(int64_t)CgVar_get(p, 8);
+	t.tv_usec = CgVar_get(p + 8, 4);
+	cv_time_set(cv, t);
+	break;
+    case CGV_STRING:
+    case CGV_REST:
+    case CGV_INTERFACE:
+    case CGV_URL:
+	if ((str = malloc(len + 1)) == NULL) {
+	    PyErr_NoMemory();
+	    goto fail;
+	}
+	memcpy(str, p, len);
+	str[len] = '\0';
+	if (type == CGV_URL) {
+	    Tmp = PyObject_CallMethod((PyObject *)Cv, "_parse", "s", str);
+	    Py_XDECREF(Tmp);
+	    ret = (Tmp == NULL) ? -1 : 0;
+	} else if ((ret = cv_string_set(cv, str) ? 0 : -1) < 0)
+	    PyErr_NoMemory();
+	free(str);
+	if (ret < 0)
+	    goto fail;
+	break;
+    default:
+	break;
+    }
+
+    return (PyObject *)Cv;
+
+invalid:
+    PyErr_Format(PyExc_ValueError, "invalid encoding of type '%s'",
+		 cv_type2str(type));
+fail:
+    Py_DECREF(Cv);
+    return NULL;
+}
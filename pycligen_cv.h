@@ -26,10 +26,27 @@
 #include <cligen/cligen.h>
 
 int CgVar_init_object(PyObject *m);
+void CgVar_fini_object(void);
 
 extern PyTypeObject CgVar_Type;
+extern uint64_t CgVar_name_epoch;
 
 PyObject *CgVar_Instance(cg_var *cv);
 cg_var *CgVar_cv(PyObject *Cv);
+PyObject *CgVar_name(PyObject *Cv);
+PyObject *CgVar_value(PyObject *Cv);
+PyObject *CgVar_parse_bulk(PyObject *self, PyObject *args);
+
+int CgVar_isshared(PyObject *Cv);
+void CgVar_share(PyObject *Cv);
+PyObject *CgVar_unshare(PyObject *Cv);
+
+size_t CgVar_pack_size(enum cv_type type, const char **fmt);
+void CgVar_pack(cg_var *cv, char *dst, uint8_t *masklen);
+
+Py_ssize_t CgVar_encode_len(PyObject *Cv);
+int CgVar_encode(PyObject *Cv, char *p);
+PyObject *CgVar_decode(int type, PyObject *Name, int cnst, int flag,
+		       const char *p, Py_ssize_t len);
 
 #endif /* _PY_CLIGEN_CV_H_ */
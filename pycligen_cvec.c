@@ -20,33 +20,699 @@
  * <http://www.gnu.org/licenses/>.
  */
 
+#define PY_SSIZE_T_CLEAN
 #include <Python.h>
 
 #include <cligen/cligen.h>
 
 #include "pycligen.h"
 #include "pycligen_cv.h"
+#include "pycligen_cvec.h"
 
+/*
+ * A Cvec holds its variables in a list that only the Cvec references; _cvec
+ * gets and sets copies of it. Lookups by name go through an index mapping
+ * each interned variable name to the list index of the first variable with
+ * that name. The index is built on demand and dropped whenever the list
+ * changes other than by appending, or when any variable has been renamed
+ * since it was built.
+ */
 typedef struct {
     PyObject_HEAD
+    PyObject *cv_list;    /* List of CgVar objects */
+    PyObject *cv_index;   /* Name to index dict, NULL if not built */
+    uint64_t  cv_epoch;   /* CgVar_name_epoch when cv_index was built */
 } Cvec;
 
 
+static int
+Cvec_traverse(Cvec *self, visitproc visit, void *arg)
+{
+    Py_VISIT(self->cv_list);
+    Py_VISIT(self->cv_index);
+    return 0;
+}
+
+static int
+Cvec_clear(Cvec *self)
+{
+    Py_CLEAR(self->cv_list);
+    Py_CLEAR(self->cv_index);
+    return 0;
+}
+
 static void
 Cvec_dealloc(Cvec* self)
 {
+    PyObject_GC_UnTrack(self);
+    Cvec_clear(self);
     Py_TYPE(self)->tp_free((PyObject*)self);
 }
 
 static PyObject *
 Cvec_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
 {
-    return (PyObject *)type->tp_alloc(type, 0);
+    Cvec *self;
+
+    if ((self = (Cvec *)type->tp_alloc(type, 0)) == NULL)
+	return NULL;
+    if ((self->cv_list = PyList_New(0)) == NULL) {
+	Py_DECREF(self);
+	return NULL;
+    }
+
+    return (PyObject *)self;
+}
+
+/*
+ * Get the name index, building it if needed. Returns a borrowed reference.
+ */
+static PyObject *
+Cvec_index_get(Cvec *self)
+{
+    Py_ssize_t i;
+    PyObject *Cv;
+    PyObject *Name;
+    PyObject *Idx;
+
+    if (self->cv_index && self->cv_epoch == CgVar_name_epoch)
+	return self->cv_index;
+
+    Py_CLEAR(self->cv_index);
+    if ((self->cv_index = PyDict_New()) == NULL)
+	return NULL;
+    self->cv_epoch = CgVar_name_epoch;
+    for (i = PyList_GET_SIZE(self->cv_list) - 1; i >= 0; i--) {
+	Cv = PyList_GET_ITEM(self->cv_list, i);
+	if (!PyObject_TypeCheck(Cv, &CgVar_Type))
+	    continue;
+	if ((Name = CgVar_name(Cv)) == NULL || 
+	    (Idx = PyLong_FromSsize_t(i)) == NULL)
+	    goto fail;
+	if (Name != Py_None && PyDict_SetItem(self->cv_index, Name, Idx) < 0) {
+	    Py_DECREF(Idx);
+	    goto fail;
+	}
+	Py_DECREF(Idx);
+    }
+
+    return self->cv_index;
+
+fail:
+    Py_CLEAR(self->cv_index);
+    return NULL;
+}
+
+/*
+ * Find the index of the first variable named 'name'. Returns -1 if not
+ * found, -2 on error.
+ */
+static Py_ssize_t
+Cvec_find(Cvec *self, PyObject *Name)
+{
+    Py_ssize_t idx;
+    PyObject *Index;
+    PyObject *Idx;
+
+    if ((Index = Cvec_index_get(self)) == NULL)
+	return -2;
+    if ((Idx = PyDict_GetItemWithError(Index, Name)) == NULL)
+	return PyErr_Occurred() ? -2 : -1;
+    if ((idx = PyLong_AsSsize_t(Idx)) == -1 && PyErr_Occurred())
+	return -2;
+
+    return idx;
+}
+
+/*
+ * Append a CgVar to the list, keeping the index up to date if built
+ */
+static int
+Cvec_append_cv(Cvec *self, PyObject *Cv)
+{
+    int ret;
+    PyObject *Name;
+    PyObject *Idx;
+
+    if (PyList_Append(self->cv_list, Cv) < 0)
+	return -1;
+    if (self->cv_index == NULL || self->cv_epoch != CgVar_name_epoch)
+	return 0;
+
+    if ((Name = CgVar_name(Cv)) == NULL)
+	return -1;
+    if (Name == Py_None || PyDict_Contains(self->cv_index, Name))
+	return 0;
+    if ((Idx = PyLong_FromSsize_t(PyList_GET_SIZE(self->cv_list) - 1)) == NULL)
+	return -1;
+    ret = PyDict_SetItem(self->cv_index, Name, Idx);
+    Py_DECREF(Idx);
+
+    return ret;
+}
+
+/*
+ * Copy-on-write.
+ *
+ * Copies of a Cvec, and Cvecs concatenated from others, share the CgVar
+ * objects of the originals instead of copying them. A CgVar is only shared
+ * while nothing but Cvec lists reference it, which holds as long as the
+ * CgVar has not been handed out. Before a Cvec hands
+ * out a shared CgVar, or changes it, it replaces it in its list with a private
+ * copy, unless the list has meanwhile become its only reference.
+ */
+
+/*
+ * Get the variable at idx, unsharing it first. Returns a borrowed reference.
+ */
+static PyObject *
+Cvec_item(Cvec *self, Py_ssize_t idx)
+{
+    PyObject *Cv;
+    PyObject *New;
+
+    Cv = PyList_GET_ITEM(self->cv_list, idx);
+    if (!PyObject_TypeCheck(Cv, &CgVar_Type) || !CgVar_isshared(Cv))
+	return Cv;
+    if ((New = CgVar_unshare(Cv)) == NULL)
+	return NULL;
+    if (New == Cv) {
+	Py_DECREF(New);
+	return Cv;
+    }
+    PyList_SET_ITEM(self->cv_list, idx, New);
+    Py_DECREF(Cv);
+
+    return New;
+}
+
+/*
+ * Unshare all variables, before handing out a copy of the list
+ */
+static int
+Cvec_unshare(Cvec *self)
+{
+    Py_ssize_t i;
+
+    for (i = 0; i < PyList_GET_SIZE(self->cv_list); i++)
+	if (Cvec_item(self, i) == NULL)
+	    return -1;
+
+    return 0;
+}
+
+/*
+ * Append the variables of other to self, sharing them where possible.
+ * Variables referenced outside the Cvec lists are copied.
+ */
+static int
+Cvec_share(Cvec *self, Cvec *other)
+{
+    int ret;
+    Py_ssize_t i;
+    Py_ssize_t n;
+    PyObject *Cv;
+
+    n = PyList_GET_SIZE(other->cv_list);  /* other may be self */
+    for (i = 0; i < n; i++) {
+	Cv = PyList_GET_ITEM(other->cv_list, i);
+	if (!PyObject_TypeCheck(Cv, &CgVar_Type)) {
+	    PyErr_SetString(PyExc_TypeError, "Cvec element must be CgVar");
+	    return -1;
+	}
+	if (CgVar_isshared(Cv) || Py_REFCNT(Cv) == 1) {
+	    CgVar_share(Cv);
+	    Py_INCREF(Cv);
+	} else if ((Cv = CgVar_Instance(CgVar_cv(Cv))) == NULL)
+	    return -1;
+	ret = Cvec_append_cv(self, Cv);
+	Py_DECREF(Cv);
+	if (ret < 0)
+	    return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Get list index from an int or name key. Returns -1 with an exception set
+ * if the key is invalid or not found.
+ */
+static Py_ssize_t
+Cvec_key2idx(Cvec *self, PyObject *key)
+{
+    Py_ssize_t idx;
+    Py_ssize_t len = PyList_GET_SIZE(self->cv_list);
+
+    if (PyLong_Check(key)) {
+	if ((idx = PyNumber_AsSsize_t(key, PyExc_IndexError)) == -1 && 
+	    PyErr_Occurred())
+	    return -1;
+	if (idx < 0)
+	    idx += len;
+	if (idx < 0 || idx >= len) {
+	    PyErr_SetString(PyExc_IndexError, "list index out of range");
+	    return -1;
+	}
+	return idx;
+    }
+    if (PyUnicode_Check(key)) {
+	if ((idx = Cvec_find(self, key)) == -1)
+	    PyErr_SetString(PyExc_IndexError, "element not found");
+	return (idx < 0) ? -1 : idx;
+    }
+
+    PyErr_SetString(PyExc_TypeError, "key must be int or str");
+    return -1;
+}
+
+static PyObject *
+Cvec_append(Cvec *self, PyObject *arg)
+{
+    PyObject *Cv;
+
+    if (PyLong_Check(arg)) {
+	if ((Cv = PyObject_CallMethod(__cligen_module(), "CgVar", "O", arg)) 
+	    == NULL)
+	    return NULL;
+    } else if (PyObject_TypeCheck(arg, &CgVar_Type)) {
+	Py_INCREF(arg);
+	Cv = arg;
+    } else {
+	PyErr_SetString(PyExc_TypeError, "argument must be int or CgVar");
+	return NULL;
+    }
+
+    if (Cvec_append_cv(self, Cv) < 0) {
+	Py_DECREF(Cv);
+	return NULL;
+    }
+
+    return Cv;
 }
 
 static int
 Cvec_init(Cvec *self, PyObject *args, PyObject *kwds)
 {
+    Py_ssize_t i;
+    PyObject *arg = Py_None;
+    PyObject *Cv;
+    static char *kwlist[] = {"arg", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &arg))
+        return -1;
+
+    if (PyList_SetSlice(self->cv_list, 0, PyList_GET_SIZE(self->cv_list),
+			NULL) < 0)
+	return -1;
+    Py_CLEAR(self->cv_index);
+    if (arg == Py_None)
+	return 0;
+    if (!PyList_Check(arg)) {
+	PyErr_SetNone(PyExc_ValueError);
+	return -1;
+    }
+    for (i = 0; i < PyList_GET_SIZE(arg); i++) {
+	if ((Cv = Cvec_append(self, PyList_GET_ITEM(arg, i))) == NULL)
+	    return -1;
+	Py_DECREF(Cv);
+    }
+
+    return 0;
+}
+
+static PyObject *
+Cvec_repr(Cvec *self)
+{
+    return PyObject_Repr(self->cv_list);
+}
+
+static Py_ssize_t
+Cvec_length(Cvec *self)
+{
+    return PyList_GET_SIZE(self->cv_list);
+}
+
+/*
+ * Iterator over a Cvec, unsharing each variable only as it is handed out
+ */
+typedef struct {
+    PyObject_HEAD
+    Cvec      *ci_vec;    /* Cvec iterated, NULL when exhausted */
+    Py_ssize_t ci_idx;    /* Index of the next variable */
+} CvecIter;
+
+static int
+CvecIter_traverse(CvecIter *self, visitproc visit, void *arg)
+{
+    Py_VISIT(self->ci_vec);
+    return 0;
+}
+
+static void
+CvecIter_dealloc(CvecIter *self)
+{
+    PyObject_GC_UnTrack(self);
+    Py_CLEAR(self->ci_vec);
+    PyObject_GC_Del(self);
+}
+
+static PyObject *
+CvecIter_next(CvecIter *self)
+{
+    PyObject *Cv;
+    Cvec *vec = self->ci_vec;
+
+    if (vec == NULL)
+	return NULL;
+    if (vec->cv_list == NULL || self->ci_idx >= PyList_GET_SIZE(vec->cv_list)) {
+	Py_CLEAR(self->ci_vec);
+	return NULL;
+    }
+    if ((Cv = Cvec_item(vec, self->ci_idx)) == NULL)
+	return NULL;
+    self->ci_idx++;
+    Py_INCREF(Cv);
+
+    return Cv;
+}
+
+static PyTypeObject CvecIter_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "_cligen.CvecIterator",    /* tp_name */
+    sizeof(CvecIter),          /* tp_basicsize */
+    0,                         /* tp_itemsize */
+    (destructor)CvecIter_dealloc, /* tp_dealloc */
+    0,                         /* tp_print */
+    0,                         /* tp_getattr */
+    0,                         /* tp_setattr */
+    0,                         /* tp_reserved */
+    0,                         /* tp_repr */
+    0,                         /* tp_as_number */
+    0,                         /* tp_as_sequence */
+    0,                         /* tp_as_mapping */
+    0,                         /* tp_hash  */
+    0,                         /* tp_call */
+    0,                         /* tp_str */
+    PyObject_GenericGetAttr,   /* tp_getattro */
+    0,                         /* tp_setattro */
+    0,                         /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT |
+        Py_TPFLAGS_HAVE_GC,    /* tp_flags */
+    "Cvec iterator objects",   /* tp_doc */
+    (traverseproc)CvecIter_traverse, /* tp_traverse */
+    0,                         /* tp_clear */
+    0,                         /* tp_richcompare */
+    0,                         /* tp_weaklistoffset */
+    PyObject_SelfIter,         /* tp_iter */
+    (iternextfunc)CvecIter_next, /* tp_iternext */
+};
+
+static PyObject *
+Cvec_iter(Cvec *self)
+{
+    CvecIter *it;
+
+    if ((it = PyObject_GC_New(CvecIter, &CvecIter_Type)) == NULL)
+	return NULL;
+    Py_INCREF(self);
+    it->ci_vec = self;
+    it->ci_idx = 0;
+    PyObject_GC_Track(it);
+
+    return (PyObject *)it;
+}
+
+static int
+Cvec_contains(Cvec *self, PyObject *key)
+{
+    Py_ssize_t idx;
+
+    if (!PyUnicode_Check(key))
+	return 0;
+    if ((idx = Cvec_find(self, key)) == -2)
+	return -1;
+
+    return (idx >= 0);
+}
+
+static PyObject *
+Cvec_subscript(Cvec *self, PyObject *key)
+{
+    Py_ssize_t idx;
+    PyObject *Cv;
+
+    if ((idx = Cvec_key2idx(self, key)) < 0)
+	return NULL;
+    if ((Cv = Cvec_item(self, idx)) == NULL)
+	return NULL;
+    Py_INCREF(Cv);
+
+    return Cv;
+}
+
+static int
+Cvec_ass_subscript(Cvec *self, PyObject *key, PyObject *value)
+{
+    Py_ssize_t idx;
+    PyObject *Cv;
+    PyObject *ret;
+
+    if ((idx = Cvec_key2idx(self, key)) < 0)
+	return -1;
+
+    if (value == NULL) {
+	Py_CLEAR(self->cv_index);
+	return PySequence_DelItem(self->cv_list, idx);
+    }
+    if (PyObject_TypeCheck(value, &CgVar_Type)) {
+	Py_CLEAR(self->cv_index);
+	Py_INCREF(value);
+	return PyList_SetItem(self->cv_list, idx, value);
+    }
+    if (PyUnicode_Check(value)) {
+	if ((Cv = Cvec_item(self, idx)) == NULL)
+	    return -1;
+	ret = PyObject_CallMethod(Cv, "parse", "O", value);
+	Py_XDECREF(ret);
+	return ret ? 0 : -1;
+    }
+
+    PyErr_SetString(PyExc_TypeError, "cv must be CgVar or str");
+    return -1;
+}
+
+static PyObject *
+Cvec_inplace_add(Cvec *self, PyObject *other)
+{
+    PyObject *Cv;
+
+    if (PyObject_TypeCheck(other, &Cvec_Type)) {
+	if (Cvec_share(self, (Cvec *)other) < 0)
+	    return NULL;
+    } else if (PyObject_TypeCheck(other, &CgVar_Type)) {
+	if ((Cv = Cvec_append(self, other)) == NULL)
+	    return NULL;
+	Py_DECREF(Cv);
+    } else {
+	PyErr_Format(PyExc_TypeError, "unsupported operand type for +: '%s'",
+		     Py_TYPE(other)->tp_name);
+	return NULL;
+    }
+
+    Py_INCREF(self);
+    return (PyObject *)self;
+}
+
+/*
+ * Copy self, sharing the variables until either copy changes them
+ */
+static PyObject *
+Cvec_copy(Cvec *self)
+{
+    PyObject *New;
+
+    if ((New = PyObject_CallObject((PyObject *)Py_TYPE(self), NULL)) == NULL)
+	return NULL;
+    if (Cvec_share((Cvec *)New, self) < 0) {
+	Py_DECREF(New);
+	return NULL;
+    }
+
+    return New;
+}
+
+static PyObject *
+Cvec_deepcopy(Cvec *self, PyObject *memo)
+{
+    return Cvec_copy(self);
+}
+
+static PyObject *
+Cvec_add(PyObject *self, PyObject *other)
+{
+    PyObject *New;
+    PyObject *ret;
+
+    if (!PyObject_TypeCheck(self, &Cvec_Type))
+	Py_RETURN_NOTIMPLEMENTED;
+    if (!PyObject_TypeCheck(other, &Cvec_Type) && 
+	!PyObject_TypeCheck(other, &CgVar_Type)) {
+	PyErr_Format(PyExc_TypeError, "unsupported operand type for +: '%s'",
+		     Py_TYPE(other)->tp_name);
+	return NULL;
+    }
+
+    if ((New = Cvec_copy((Cvec *)self)) == NULL)
+	return NULL;
+    ret = Cvec_inplace_add((Cvec *)New, other);
+    Py_DECREF(New);
+
+    return ret;
+}
+
+static PyObject *
+Cvec_index(Cvec *self, PyObject *val)
+{
+    int eq;
+    Py_ssize_t i;
+
+    if (PyUnicode_Check(val)) {
+	if ((i = Cvec_find(self, val)) == -2)
+	    return NULL;
+    } else if (PyObject_TypeCheck(val, &CgVar_Type)) {
+	for (i = 0; i < PyList_GET_SIZE(self->cv_list); i++) {
+	    eq = PyObject_RichCompareBool(PyList_GET_ITEM(self->cv_list, i),
+					  val, Py_EQ);
+	    if (eq < 0)
+		return NULL;
+	    if (eq)
+		break;
+	}
+	if (i == PyList_GET_SIZE(self->cv_list))
+	    i = -1;
+    } else {
+	PyErr_SetNone(PyExc_ValueError);
+	return NULL;
+    }
+
+    if (i < 0)
+	Py_RETURN_NONE;
+    return PyLong_FromSsize_t(i);
+}
+
+static PyObject *
+Cvec_keys(Cvec *self)
+{
+    Py_ssize_t i;
+    PyObject *Keys;
+    PyObject *Cv;
+    PyObject *Name;
+
+    if ((Keys = PyList_New(0)) == NULL)
+	return NULL;
+    for (i = 0; i < PyList_GET_SIZE(self->cv_list); i++) {
+	Cv = PyList_GET_ITEM(self->cv_list, i);
+	if (!PyObject_TypeCheck(Cv, &CgVar_Type))
+	    continue;
+	if ((Name = CgVar_name(Cv)) == NULL) {
+	    Py_DECREF(Keys);
+	    return NULL;
+	}
+	if (Name != Py_None && PyList_Append(Keys, Name) < 0) {
+	    Py_DECREF(Keys);
+	    return NULL;
+	}
+    }
+
+    return Keys;
+}
+
+/*
+ * Build a dict mapping variable names to their values (see CgVar.value) in
+ * one pass. If 'names' is given only variables with a name contained in it
+ * are included. As for lookups, the first variable with a name is used.
+ */
+static PyObject *
+Cvec_as_dict(Cvec *self, PyObject *args, PyObject *kwds)
+{
+    int ret;
+    Py_ssize_t i;
+    PyObject *Names = Py_None;
+    PyObject *Dict;
+    PyObject *Cv;
+    PyObject *Name;
+    PyObject *Value;
+    static char *kwlist[] = {"names", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &Names))
+        return NULL;
+
+    if ((Dict = PyDict_New()) == NULL)
+	return NULL;
+    for (i = 0; i < PyList_GET_SIZE(self->cv_list); i++) {
+	Cv = PyList_GET_ITEM(self->cv_list, i);
+	if (!PyObject_TypeCheck(Cv, &CgVar_Type))
+	    continue;
+	if ((Name = CgVar_name(Cv)) == NULL)
+	    goto fail;
+	if (Name == Py_None)
+	    continue;
+	if (Names != Py_None) {
+	    if ((ret = PySequence_Contains(Names, Name)) < 0)
+		goto fail;
+	    if (ret == 0)
+		continue;
+	}
+	if ((ret = PyDict_Contains(Dict, Name)) < 0)
+	    goto fail;
+	if (ret)
+	    continue;
+	if ((Value = CgVar_value(Cv)) == NULL)
+	    goto fail;
+	ret = PyDict_SetItem(Dict, Name, Value);
+	Py_DECREF(Value);
+	if (ret < 0)
+	    goto fail;
+    }
+
+    return Dict;
+
+fail:
+    Py_DECREF(Dict);
+    return NULL;
+}
+
+/*
+ * A copy of the variable list. The variables are unshared since the caller
+ * gets references to them.
+ */
+static PyObject *
+Cvec_list_get(Cvec *self, void *closure)
+{
+    if (Cvec_unshare(self) < 0)
+	return NULL;
+    return PyList_GetSlice(self->cv_list, 0, PyList_GET_SIZE(self->cv_list));
+}
+
+/*
+ * Replace the variable list with a copy of List
+ */
+static int
+Cvec_list_set(Cvec *self, PyObject *List, void *closure)
+{
+    PyObject *New;
+
+    if (List == NULL || !PyList_Check(List)) {
+	PyErr_SetString(PyExc_TypeError, "_cvec must be a list");
+	return -1;
+    }
+    if ((New = PyList_GetSlice(List, 0, PyList_GET_SIZE(List))) == NULL)
+	return -1;
+    Py_CLEAR(self->cv_index);
+    Py_DECREF(self->cv_list);
+    self->cv_list = New;
+
     return 0;
 }
 
@@ -55,12 +721,10 @@ Cvec_init(Cvec *self, PyObject *args, PyObject *kwds)
  * Create CLIgen.Cvec instance from cvec
  */
 PyObject *
-__Cvec_from_cvec(PyObject *self, PyObject *args)
+__Cvec_from_cvec(Cvec *self, PyObject *args)
 {
     PyObject *Capsule = NULL;
     PyObject *Cv = NULL;
-    PyObject *Method = NULL;
-    PyObject *Ret;
     cvec *vr = NULL;
     cg_var *cv;
 
@@ -74,24 +738,450 @@ __Cvec_from_cvec(PyObject *self, PyObject *args)
     for (cv = NULL; (cv = cvec_each(vr, cv)); ) {	
 	if ((Cv = CgVar_Instance(cv)) == NULL)
 	    return NULL;
-	
-	if ((Method = StringFromString("append")) == NULL)
+	if (Cvec_append_cv(self, Cv) < 0) {
+	    Py_DECREF(Cv);
 	    return NULL;
-	
-	Ret = PyObject_CallMethodObjArgs(self, Method, Cv, NULL);
-	Py_DECREF(Method);
+	}
 	Py_DECREF(Cv);  /* leave only reference owned by Cvec object */
-	if (Ret == NULL)
-	    return NULL;
-	Py_DECREF(Ret);
     }
 
     Py_RETURN_NONE;
 }
 
+/*
+ * Wire format.
+ *
+ * A Cvec, or a single CgVar, is encoded as a header, a table of the distinct
+ * variable names and the variables. All integers are little-endian:
+ *
+ *   magic "CG" (2), version (1), kind (1, 0 for a CgVar, 1 for a Cvec)
+ *   number of names (2), then for each name: length (2), UTF-8 name
+ *   number of variables (4), then for each variable:
+ *     type (1), const (1), flags (1), name id (2, 0xffff if no name),
+ *     value length (4), value as encoded by CgVar_encode()
+ *
+ * Decoding reads straight from the buffer, so a memoryview of shared memory
+ * can be decoded without copying it first.
+ */
+#define CVEC_WIRE_VERSION   1
+#define CVEC_WIRE_HDRLEN    4
+#define CVEC_WIRE_VARLEN    9
+#define CVEC_WIRE_NONAME    0xffff
+
+static char *
+Cvec_wire_put(char *p, uint32_t val, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++, val >>= 8)
+	*p++ = val & 0xff;
+
+    return p;
+}
+
+static uint32_t
+Cvec_wire_get(const char *p, int len)
+{
+    int i;
+    uint32_t val = 0;
+
+    for (i = len - 1; i >= 0; i--)
+	val = (val << 8) | (unsigned char)p[i];
+
+    return val;
+}
+
+/*
+ * Encode a sequence of CgVar objects. Returns a new bytes object.
+ */
+PyObject *
+Cvec_encode_seq(PyObject *Seq, int kind)
+{
+    Py_ssize_t i;
+    Py_ssize_t n;
+    Py_ssize_t size;
+    Py_ssize_t len;
+    Py_ssize_t *lens = NULL;
+    Py_ssize_t nlen;
+    const char *name;
+    char *p;
+    cg_var *cv;
+    PyObject *Cv;
+    PyObject *Name;
+    PyObject *Id;
+    PyObject *Ids = NULL;
+    PyObject *Names = NULL;
+    PyObject *ret = NULL;
+
+    n = PySequence_Fast_GET_SIZE(Seq);
+    if ((lens = malloc((n ? n : 1) * sizeof(*lens))) == NULL) {
+	PyErr_NoMemory();
+	goto done;
+    }
+    if ((Ids = PyDict_New()) == NULL || (Names = PyList_New(0)) == NULL)
+	goto done;
+
+    size = CVEC_WIRE_HDRLEN + 2 + 4;
+    for (i = 0; i < n; i++) {
+	Cv = PySequence_Fast_GET_ITEM(Seq, i);
+	if (!PyObject_TypeCheck(Cv, &CgVar_Type)) {
+	    PyErr_SetString(PyExc_TypeError, "Cvec element must be CgVar");
+	    goto done;
+	}
+	if ((Name = CgVar_name(Cv)) == NULL)
+	    goto done;
+	if (Name != Py_None && !PyDict_Contains(Ids, Name)) {
+	    if (PyList_GET_SIZE(Names) >= CVEC_WIRE_NONAME) {
+		PyErr_SetString(PyExc_OverflowError, "too many variable names");
+		goto done;
+	    }
+	    if ((name = PyUnicode_AsUTF8AndSize(Name, &nlen)) == NULL)
+		goto done;
+	    if (nlen > 0xffff) {
+		PyErr_SetString(PyExc_OverflowError, "variable name too long");
+		goto done;
+	    }
+	    if ((Id = PyLong_FromSsize_t(PyList_GET_SIZE(Names))) == NULL)
+		goto done;
+	    if (PyDict_SetItem(Ids, Name, Id) < 0) {
+		Py_DECREF(Id);
+		goto done;
+	    }
+	    Py_DECREF(Id);
+	    if (PyList_Append(Names, Name) < 0)
+		goto done;
+	    size += 2 + nlen;
+	}
+	if ((len = CgVar_encode_len(Cv)) < 0)
+	    goto done;
+	if (len > 0xffffffff) {
+	    PyErr_SetString(PyExc_OverflowError, "variable value too long");
+	    goto done;
+	}
+	lens[i] = len;
+	size += CVEC_WIRE_VARLEN + len;
+    }
+
+    if ((ret = PyBytes_FromStringAndSize(NULL, size)) == NULL)
+	goto done;
+    p = PyBytes_AS_STRING(ret);
+    *p++ = 'C';
+    *p++ = 'G';
+    *p++ = CVEC_WIRE_VERSION;
+    *p++ = kind;
+
+    p = Cvec_wire_put(p, PyList_GET_SIZE(Names), 2);
+    for (i = 0; i < PyList_GET_SIZE(Names); i++) {
+	name = PyUnicode_AsUTF8AndSize(PyList_GET_ITEM(Names, i), &nlen);
+	p = Cvec_wire_put(p, nlen, 2);
+	memcpy(p, name, nlen);
+	p += nlen;
+    }
+
+    p = Cvec_wire_put(p, n, 4);
+    for (i = 0; i < n; i++) {
+	Cv = PySequence_Fast_GET_ITEM(Seq, i);
+	cv = CgVar_cv(Cv);
+	Name = CgVar_name(Cv);
+	Id = (Name == Py_None) ? NULL : PyDict_GetItem(Ids, Name);
+	p = Cvec_wire_put(p, cv_type_get(cv), 1);
+	p = Cvec_wire_put(p, cv_const_get(cv) ? 1 : 0, 1);
+	p = Cvec_wire_put(p, (unsigned char)cv_flag(cv, (char)0xff), 1);
+	p = Cvec_wire_put(p, Id ? PyLong_AsLong(Id) : CVEC_WIRE_NONAME, 2);
+	p = Cvec_wire_put(p, lens[i], 4);
+	if (CgVar_encode(Cv, p) < 0) {
+	    Py_CLEAR(ret);
+	    goto done;
+	}
+	p += lens[i];
+    }
+
+done:
+    free(lens);
+    Py_XDECREF(Ids);
+    Py_XDECREF(Names);
+    return ret;
+}
+
+/*
+ * Decode a CgVar or Cvec from the wire format
+ */
+PyObject *
+Cvec_decode(PyObject *self, PyObject *args)
+{
+    int kind;
+    int type;
+    uint32_t id;
+    uint32_t i;
+    uint32_t n;
+    uint32_t len;
+    Py_buffer buf;
+    const char *p;
+    const char *end;
+    PyObject *Name;
+    PyObject *Names = NULL;
+    PyObject *Cv = NULL;
+    PyObject *Vec = NULL;
+    PyObject *ret = NULL;
+
+    if (!PyArg_ParseTuple(args, "y*", &buf))
+	return NULL;
+    p = buf.buf;
+    end = p + buf.len;
+
+#define NEED(l)  if (end - p < (Py_ssize_t)(l)) goto invalid
+    NEED(CVEC_WIRE_HDRLEN);
+    if (p[0] != 'C' || p[1] != 'G' || p[2] != CVEC_WIRE_VERSION || 
+	(p[3] != 0 && p[3] != 1))
+	goto invalid;
+    kind = p[3];
+    p += CVEC_WIRE_HDRLEN;
+
+    NEED(2);
+    n = Cvec_wire_get(p, 2);
+    p += 2;
+    if ((Names = PyList_New(n)) == NULL)
+	goto done;
+    for (i = 0; i < n; i++) {
+	NEED(2);
+	len = Cvec_wire_get(p, 2);
+	p += 2;
+	NEED(len);
+	if ((Name = PyUnicode_DecodeUTF8(p, len, NULL)) == NULL)
+	    goto done;
+	PyUnicode_InternInPlace(&Name);
+	PyList_SET_ITEM(Names, i, Name);
+	p += len;
+    }
 
+    NEED(4);
+    n = Cvec_wire_get(p, 4);
+    p += 4;
+    if (kind == 0 && n != 1)
+	goto invalid;
+    if (kind == 1 && 
+	(Vec = PyObject_CallMethod(__cligen_module(), "Cvec", NULL)) == NULL)
+	goto done;
+    for (i = 0; i < n; i++) {
+	NEED(CVEC_WIRE_VARLEN);
+	type = Cvec_wire_get(p, 1);
+	id = Cvec_wire_get(p + 3, 2);
+	len = Cvec_wire_get(p + 5, 4);
+	if (id != CVEC_WIRE_NONAME && id >= PyList_GET_SIZE(Names))
+	    goto invalid;
+	Name = (id == CVEC_WIRE_NONAME) ? Py_None : PyList_GET_ITEM(Names, id);
+	p += CVEC_WIRE_VARLEN;
+	NEED(len);
+	if ((Cv = CgVar_decode(type, Name, Cvec_wire_get(p - 8, 1), 
+			       Cvec_wire_get(p - 7, 1), p, len)) == NULL)
+	    goto done;
+	p += len;
+	if (kind == 0)
+	    break;
+	if (Cvec_append_cv((Cvec *)Vec, Cv) < 0)
+	    goto done;
+	Py_CLEAR(Cv);
+    }
+    if (p != end)
+	goto invalid;
+#undef NEED
+
+    if (kind == 0) {
+	ret = Cv;
+	Cv = NULL;
+    } else {
+	ret = Vec;
+	Vec = NULL;
+    }
+    goto done;
+
+invalid:
+    PyErr_SetString(PyExc_ValueError, "invalid CgVar or Cvec encoding");
+done:
+    PyBuffer_Release(&buf);
+    Py_XDECREF(Names);
+    Py_XDECREF(Cv);
+    Py_XDECREF(Vec);
+    return ret;
+}
+
+static PyObject *
+Cvec_encode(Cvec *self)
+{
+    return Cvec_encode_seq(self->cv_list, 1);
+}
+
+/*
+ * Pickle as cligen.decode(self.encode())
+ */
+static PyObject *
+Cvec_reduce(Cvec *self)
+{
+    PyObject *Decode;
+
+    if ((Decode = PyObject_GetAttrString(__cligen_module(), "decode")) == NULL)
+	return NULL;
+
+    return Py_BuildValue("(N(N))", Decode, Cvec_encode(self));
+}
+
+/*
+ * Buffer protocol.
+ *
+ * A Cvec whose variables are all of the same numeric or address type exports
+ * their values as a read-only contiguous buffer, packed as by parse_bulk():
+ * one native integer or double per variable, IPv4 addresses as uint32 in host
+ * byte order and IPv6 addresses and UUIDs as rows of 16 bytes. Prefix mask
+ * lengths are not exported.
+ *
+ * The values are a snapshot taken when the buffer is requested. They are
+ * packed into a block owned by the view and released with it.
+ */
+typedef struct {
+    Py_ssize_t cb_shape[2];
+    Py_ssize_t cb_strides[2];
+    char       cb_fmt[2];
+    char       cb_data[];
+} CvecBuffer;
+
+static int
+Cvec_getbuffer(PyObject *self, Py_buffer *view, int flags)
+{
+    Py_ssize_t i;
+    Py_ssize_t n;
+    size_t size = 1;
+    uint8_t masklen;
+    const char *fmt = "B";
+    enum cv_type type = CGV_ERR;
+    cg_var *cv;
+    CvecBuffer *cb;
+    PyObject *List;
+    PyObject *Cv;
+
+    if (flags & PyBUF_WRITABLE) {
+	PyErr_SetString(PyExc_BufferError, "Cvec buffer is read-only");
+	return -1;
+    }
+    List = ((Cvec *)self)->cv_list;
+
+    /* All variables must be of the same packable type */
+    n = PyList_GET_SIZE(List);
+    for (i = 0; i < n; i++) {
+	if ((cv = CgVar_cv(PyList_GET_ITEM(List, i))) == NULL)
+	    goto fail;
+	if (i == 0) {
+	    type = cv_type_get(cv);
+	    size = CgVar_pack_size(type, &fmt);
+	}
+	if (size == 0 || cv_type_get(cv) != type) {
+	    PyErr_SetString(PyExc_BufferError,
+			    "Cvec is not of a single numeric or address type");
+	    goto fail;
+	}
+    }
+
+    if ((cb = PyMem_Malloc(sizeof(*cb) + n * size)) == NULL) {
+	PyErr_NoMemory();
+	goto fail;
+    }
+    for (i = 0; i < n; i++) {
+	Cv = PyList_GET_ITEM(List, i);
+	CgVar_pack(CgVar_cv(Cv), cb->cb_data + i * size, &masklen);
+    }
+
+    strcpy(cb->cb_fmt, fmt);
+    cb->cb_shape[0] = n;
+    cb->cb_strides[0] = size;
+    if (size == 16) {  /* 16 byte addresses exported as n x 16 bytes */
+	cb->cb_shape[1] = 16;
+	cb->cb_strides[1] = 1;
+	view->itemsize = 1;
+	view->ndim = 2;
+    } else {
+	view->itemsize = size;
+	view->ndim = 1;
+    }
+
+    view->buf = cb->cb_data;
+    view->obj = self;
+    Py_INCREF(self);
+    view->len = n * size;
+    view->readonly = 1;
+    view->format = (flags & PyBUF_FORMAT) ? cb->cb_fmt : NULL;
+    view->shape = (flags & PyBUF_ND) ? cb->cb_shape : NULL;
+    view->strides = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) ? 
+	cb->cb_strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = cb;
+    if (view->shape == NULL)  /* Simple request, plain bytes */
+	view->ndim = 1;
+
+    return 0;
+
+fail:
+    view->obj = NULL;
+    return -1;
+}
+
+static void
+Cvec_releasebuffer(PyObject *self, Py_buffer *view)
+{
+    PyMem_Free(view->internal);
+}
+
+static PyBufferProcs Cvec_as_buffer = {
+    .bf_getbuffer = Cvec_getbuffer,
+    .bf_releasebuffer = Cvec_releasebuffer,
+};
+
+
+static PySequenceMethods Cvec_as_sequence = {
+    .sq_length = (lenfunc)Cvec_length,
+    .sq_contains = (objobjproc)Cvec_contains,
+};
+
+static PyMappingMethods Cvec_as_mapping = {
+    .mp_length = (lenfunc)Cvec_length,
+    .mp_subscript = (binaryfunc)Cvec_subscript,
+    .mp_ass_subscript = (objobjargproc)Cvec_ass_subscript,
+};
+
+static PyNumberMethods Cvec_as_number = {
+    .nb_add = (binaryfunc)Cvec_add,
+    .nb_inplace_add = (binaryfunc)Cvec_inplace_add,
+};
+
+static PyGetSetDef Cvec_getset[] = {
+    {"_cvec", (getter)Cvec_list_get, (setter)Cvec_list_set,
+     "A copy of the list of variables", NULL},
+    {NULL}  /* Sentinel */
+};
 
 static PyMethodDef Cvec_methods[] = {
+    {"append", (PyCFunction)Cvec_append, METH_O, 
+     "Append a CgVar, or a new CgVar of the given type"
+    },
+    {"index", (PyCFunction)Cvec_index, METH_O, 
+     "Return the index of a variable given by name or CgVar"
+    },
+    {"keys", (PyCFunction)Cvec_keys, METH_NOARGS, 
+     "Return a list of the variable names"
+    },
+    {"as_dict", (PyCFunction)Cvec_as_dict, METH_VARARGS | METH_KEYWORDS, 
+     "Return a dict of variable names and values"
+    },
+    {"__copy__", (PyCFunction)Cvec_copy, METH_NOARGS, 
+     "Copy the Cvec, sharing variables until changed"
+    },
+    {"__deepcopy__", (PyCFunction)Cvec_deepcopy, METH_O, 
+     "Copy the Cvec, sharing variables until changed"
+    },
+    {"encode", (PyCFunction)Cvec_encode, METH_NOARGS, 
+     "Encode the Cvec in the binary wire format"
+    },
+    {"__reduce__", (PyCFunction)Cvec_reduce, METH_NOARGS, 
+     "Pickle support"
+    },
     
     {"__Cvec_from_cvec", (PyCFunction)__Cvec_from_cvec, METH_VARARGS, 
      "Populate self from cvec* pointer"
@@ -111,28 +1201,29 @@ PyTypeObject Cvec_Type = {
     0,                         /* tp_getattr */
     0,                         /* tp_setattr */
     0,                         /* tp_reserved */
-    0,                         /* tp_repr */
-    0,                         /* tp_as_number */
-    0,                         /* tp_as_sequence */
-    0,                         /* tp_as_mapping */
+    (reprfunc)Cvec_repr,       /* tp_repr */
+    &Cvec_as_number,           /* tp_as_number */
+    &Cvec_as_sequence,         /* tp_as_sequence */
+    &Cvec_as_mapping,          /* tp_as_mapping */
     0,                         /* tp_hash  */
     0,                         /* tp_call */
-    0,                         /* tp_str */
+    (reprfunc)Cvec_repr,       /* tp_str */
     0,                         /* tp_getattro */
     0,                         /* tp_setattro */
-    0,                         /* tp_as_buffer */
+    &Cvec_as_buffer,           /* tp_as_buffer */
     Py_TPFLAGS_DEFAULT |
-        Py_TPFLAGS_BASETYPE,   /* tp_flags */
+        Py_TPFLAGS_BASETYPE |
+        Py_TPFLAGS_HAVE_GC,    /* tp_flags */
     "Cvec objects",            /* tp_doc */
-    0,                         /* tp_traverse */
-    0,                         /* tp_clear */
+    (traverseproc)Cvec_traverse, /* tp_traverse */
+    (inquiry)Cvec_clear,       /* tp_clear */
     0,                         /* tp_richcompare */
     0,                         /* tp_weaklistoffset */
-    0,                         /* tp_iter */
+    (getiterfunc)Cvec_iter,    /* tp_iter */
     0,                         /* tp_iternext */
     Cvec_methods,              /* tp_methods */
     0,                         /* tp_members */
-    0,                         /* tp_getset */
+    Cvec_getset,               /* tp_getset */
     0,                         /* tp_base */
     0,                         /* tp_dict */
     0,                         /* tp_descr_get */
@@ -147,7 +1238,7 @@ int
 Cvec_init_object(PyObject *m)
 {
 
-    if (PyType_Ready(&Cvec_Type) < 0)
+    if (PyType_Ready(&Cvec_Type) < 0 || PyType_Ready(&CvecIter_Type) < 0)
         return -1;
 
     Py_INCREF(&Cvec_Type);
@@ -25,4 +25,9 @@
 
 int Cvec_init_object(PyObject *m);
 
+extern PyTypeObject Cvec_Type;
+
+PyObject *Cvec_encode_seq(PyObject *Seq, int kind);
+PyObject *Cvec_decode(PyObject *self, PyObject *args);
+
 #endif /* _PY_CLIGEN_CVEC_H_ */
@@ -0,0 +1,97 @@
+/*
+ * pycligen_mem.c
+ *
+ * Copyright (C) 2014-2015 Benny Holmgren
+ *
+ * This file is part of PyCLIgen.
+ *
+ * PyCLIgen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ *  PyCLIgen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along wth PyCLIgen; see the file LICENSE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <stdint.h>
+
+#include "pycligen_mem.h"
+
+static const char *Mem_kinds[MEM_NKINDS] = {
+    "cgvar", "parsetree", "output", "file", "stats", "trace", "metrics"
+};
+
+/* Allocations and bytes in use per kind. Updated with the GIL held. */
+static uint64_t Mem_count[MEM_NKINDS];
+static uint64_t Mem_bytes[MEM_NKINDS];
+
+
+/*
+ * Account an allocation of size bytes at ptr. Tracing it fails silently if
+ * tracemalloc is not tracing.
+ */
+void
+Mem_track(int kind, const void *ptr, size_t size)
+{
+    if (ptr == NULL)
+	return;
+
+    Mem_count[kind]++;
+    Mem_bytes[kind] += size;
+#if PY_VERSION_HEX >= 0x03070000
+    PyTraceMalloc_Track(MEM_DOMAIN, (uintptr_t)ptr, size);
+#endif
+}
+
+/*
+ * Account the release of an allocation accounted with Mem_track()
+ */
+void
+Mem_untrack(int kind, const void *ptr, size_t size)
+{
+    if (ptr == NULL)
+	return;
+
+    Mem_count[kind]--;
+    Mem_bytes[kind] -= size;
+#if PY_VERSION_HEX >= 0x03070000
+    PyTraceMalloc_Untrack(MEM_DOMAIN, (uintptr_t)ptr);
+#endif
+}
+
+/*
+ * Get the allocations in use as {kind: {'count': n, 'bytes': n}}
+ */
+PyObject *
+Mem_dict(void)
+{
+    int i;
+    PyObject *Dict;
+    PyObject *Kind;
+
+    if ((Dict = PyDict_New()) == NULL)
+	return NULL;
+    for (i = 0; i < MEM_NKINDS; i++) {
+	if ((Kind = Py_BuildValue("{sKsK}",
+				  "count", (unsigned long long)Mem_count[i],
+				  "bytes", (unsigned long long)Mem_bytes[i])) == NULL ||
+	    PyDict_SetItemString(Dict, Mem_kinds[i], Kind) < 0) {
+	    Py_XDECREF(Kind);
+	    Py_DECREF(Dict);
+	    return NULL;
+	}
+	Py_DECREF(Kind);
+    }
+
+    return Dict;
+}
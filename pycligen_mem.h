@@ -0,0 +1,54 @@
+/*
+ * pycligen_mem.h
+ *
+ * Copyright (C) 2014-2015 Benny Holmgren
+ *
+ * This file is part of PyCLIgen.
+ *
+ * PyCLIgen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ *  PyCLIgen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along wth PyCLIgen; see the file LICENSE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PY_CLIGEN_MEM_H_
+#define _PY_CLIGEN_MEM_H_
+
+#include <stddef.h>
+
+/*
+ * Native memory owned by the binding is reported to tracemalloc under its
+ * own domain, so tracemalloc.DomainFilter(True, MEM_DOMAIN) shows it apart
+ * from Python's. Per kind totals are always kept, see cligen.memory().
+ *
+ * Memory allocated inside libcligen is not seen by the binding, so cg_vars
+ * and parse trees are tracked with an estimated size and traced as the
+ * allocation site that created them.
+ */
+#define MEM_DOMAIN      0x43474c00   /* "CGL" */
+
+#define MEM_CGVAR       0    /* cg_var of a CgVar */
+#define MEM_PARSETREE   1    /* parse_tree of a ParseTree */
+#define MEM_OUTPUT      2    /* Output channel buffers */
+#define MEM_FILE        3    /* FILE streams of output channels */
+#define MEM_STATS       4    /* Latency statistics */
+#define MEM_TRACE       5    /* Event tracer */
+#define MEM_METRICS     6    /* Metrics page */
+#define MEM_NKINDS      7
+
+#define MEM_CGVAR_SIZE  64   /* Estimated size of a cg_var */
+
+void Mem_track(int kind, const void *ptr, size_t size);
+void Mem_untrack(int kind, const void *ptr, size_t size);
+PyObject *Mem_dict(void);
+
+#endif /* _PY_CLIGEN_MEM_H_ */
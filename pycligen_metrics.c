@@ -0,0 +1,103 @@
+/*
+ * pycligen_metrics.c
+ *
+ * Copyright (C) 2014-2015 Benny Holmgren
+ *
+ * This file is part of PyCLIgen.
+ *
+ * PyCLIgen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ *  PyCLIgen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along wth PyCLIgen; see the file LICENSE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+
+#include "pycligen_stats.h"
+#include "pycligen_metrics.h"
+#include "pycligen_mem.h"
+
+
+/*
+ * Create the metrics file path, or reuse an existing one, and map it.
+ * The file is reset in place rather than truncated, so an agent still
+ * mapping it from a previous run sees an invalid magic, not SIGBUS.
+ * The file stays locked through the descriptor returned in fdp, so that
+ * a second writer fails with EBUSY instead of resetting a live page.
+ * Returns NULL with errno set on failure.
+ */
+Metrics *
+Metrics_open(const char *path, int *fdp)
+{
+    int fd;
+    int err;
+    void *p;
+    Metrics *m;
+
+    if ((fd = open(path, O_RDWR|O_CREAT|O_CLOEXEC, 0644)) < 0)
+	return NULL;
+    if (flock(fd, LOCK_EX|LOCK_NB) < 0) {
+	err = (errno == EWOULDBLOCK) ? EBUSY : errno;
+	goto fail;
+    }
+    if (ftruncate(fd, METRICS_SIZE) < 0) {
+	err = errno;
+	goto fail;
+    }
+    p = mmap(NULL, METRICS_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+	err = errno;
+	goto fail;
+    }
+
+    m = (Metrics *)p;
+    memset(m->mp_magic, 0, sizeof(m->mp_magic));
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memset((char *)p + sizeof(m->mp_magic), 0,
+	   METRICS_SIZE - sizeof(m->mp_magic));
+    m->mp_version = METRICS_VERSION;
+    m->mp_size = sizeof(*m);
+    m->mp_pid = getpid();
+    m->mp_start_ns = Stats_now();
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(m->mp_magic, METRICS_MAGIC, sizeof(m->mp_magic));
+    Mem_track(MEM_METRICS, m, METRICS_SIZE);
+    *fdp = fd;
+
+    return m;
+
+fail:
+    close(fd);
+    errno = err;
+    return NULL;
+}
+
+/*
+ * Unmap the metrics page and release the file. The file is left with the
+ * last counter values.
+ */
+void
+Metrics_close(Metrics *m, int fd)
+{
+    if (m == NULL)
+	return;
+
+    Mem_untrack(MEM_METRICS, m, METRICS_SIZE);
+    munmap(m, METRICS_SIZE);
+    close(fd);
+}
@@ -0,0 +1,84 @@
+/*
+ * pycligen_metrics.h
+ *
+ * Copyright (C) 2014-2015 Benny Holmgren
+ *
+ * This file is part of PyCLIgen.
+ *
+ * PyCLIgen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ *  PyCLIgen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along wth PyCLIgen; see the file LICENSE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PY_CLIGEN_METRICS_H_
+#define _PY_CLIGEN_METRICS_H_
+
+#include <stdint.h>
+
+#define METRICS_MAGIC    "CGMETRIC"
+#define METRICS_VERSION  1
+#define METRICS_SIZE     4096    /* Size of the metrics file */
+
+/*
+ * Metrics page. When enabled with CLIgen.metrics_open() the counters of a
+ * CLIgen instance are kept in a file mapped MAP_SHARED, so that monitoring
+ * agents can mmap or read it without involving the process. The layout is
+ * fixed, all fields are native endian and naturally aligned:
+ *
+ *   offset  size  field
+ *        0     8  magic "CGMETRIC", written last when the page is created
+ *        8     4  version, 1
+ *       12     4  size of the header and counters, in bytes
+ *       16     8  pid
+ *       24     8  start time, CLOCK_MONOTONIC ns
+ *       32     8  lines       command lines parsed
+ *       40     8  commands    callbacks run
+ *       48     8  errors      callbacks failed, returned < 0 or raised
+ *       56     8  nomatch     lines not matching a command
+ *       64     8  ambiguous   lines matching several commands
+ *       72     8  callback_ns total time in callbacks, ns
+ *       80     8  expands     expand callbacks run
+ *       88     8  expand_ns   total time in expand callbacks, ns
+ *       96     8  output_bytes  output written
+ *
+ * Counters only increase and are updated with relaxed atomic operations, so
+ * a reader sees each one consistent but not a snapshot of all of them. New
+ * counters are only ever appended, and the size field tells how many there
+ * are.
+ */
+typedef struct {
+    char      mp_magic[8];
+    uint32_t  mp_version;
+    uint32_t  mp_size;
+    uint64_t  mp_pid;
+    uint64_t  mp_start_ns;
+    uint64_t  mp_lines;
+    uint64_t  mp_commands;
+    uint64_t  mp_errors;
+    uint64_t  mp_nomatch;
+    uint64_t  mp_ambiguous;
+    uint64_t  mp_callback_ns;
+    uint64_t  mp_expands;
+    uint64_t  mp_expand_ns;
+    uint64_t  mp_output_bytes;
+} Metrics;
+
+#define METRICS_ADD(m, field, n) \
+    do { if (m) __atomic_fetch_add(&(m)->field, (n), __ATOMIC_RELAXED); } while (0)
+#define METRICS_SET(m, field, n) \
+    do { if (m) __atomic_store_n(&(m)->field, (n), __ATOMIC_RELAXED); } while (0)
+
+Metrics *Metrics_open(const char *path, int *fdp);
+void Metrics_close(Metrics *m, int fd);
+
+#endif /* _PY_CLIGEN_METRICS_H_ */
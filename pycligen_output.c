@@ -0,0 +1,670 @@
+/*
+ * pycligen_output.c
+ *
+ * Copyright (C) 2014-2015 Benny Holmgren
+ *
+ * This file is part of PyCLIgen.
+ *
+ * PyCLIgen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ *  PyCLIgen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along wth PyCLIgen; see the file LICENSE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <unistd.h>
+#include <termios.h>
+#include <sys/uio.h>
+
+#include <cligen/cligen.h>
+
+#include "pycligen_output.h"
+#include "pycligen_mem.h"
+#include "pycligen_probes.h"
+
+
+/*
+ * io module classes used to classify output targets
+ */
+static PyObject *io_BytesIO = NULL;
+static PyObject *io_RawIOBase = NULL;
+static PyObject *io_BufferedIOBase = NULL;
+
+/*
+ * io classes whose write() copies the data or writes it out before
+ * returning, and so can be handed a view of the output
+ */
+static const char *io_copying_names[] = {
+    "BytesIO", "BufferedWriter", "BufferedRandom", "FileIO"
+};
+#define IO_COPYING (sizeof(io_copying_names) / sizeof(io_copying_names[0]))
+static PyObject *io_copying[IO_COPYING];
+
+static int
+OutputChannel_io_init(void)
+{
+    size_t i;
+    int retval = -1;
+    PyObject *io;
+
+    if (io_BytesIO != NULL)
+	return 0;
+
+    if ((io = PyImport_ImportModule("io")) == NULL)
+	return -1;
+    for (i = 0; i < IO_COPYING; i++)
+	if ((io_copying[i] = PyObject_GetAttrString(io, io_copying_names[i])) == NULL)
+	    goto done;
+    io_RawIOBase = PyObject_GetAttrString(io, "RawIOBase");
+    io_BufferedIOBase = PyObject_GetAttrString(io, "BufferedIOBase");
+    io_BytesIO = PyObject_GetAttrString(io, "BytesIO");
+    if (io_BytesIO && io_RawIOBase && io_BufferedIOBase)
+	retval = 0;
+
+done:
+    Py_DECREF(io);
+    if (retval < 0) {
+	for (i = 0; i < IO_COPYING; i++)
+	    Py_CLEAR(io_copying[i]);
+	Py_CLEAR(io_BytesIO);
+	Py_CLEAR(io_RawIOBase);
+	Py_CLEAR(io_BufferedIOBase);
+    }
+
+    return retval;
+}
+
+/*
+ * Write all of iov to fd, restarting on partial writes and EINTR. On error
+ * iov is left describing what was not written.
+ */
+static int
+OutputChannel_writev(int fd, struct iovec *iov, int iovcnt)
+{
+    ssize_t n;
+    uint64_t t0;
+
+    while (iovcnt > 0) {
+	t0 = PROBE_NOW();
+	Py_BEGIN_ALLOW_THREADS
+	n = writev(fd, iov, iovcnt);
+	Py_END_ALLOW_THREADS
+	PROBE_OUTPUT_WRITE(fd, n, PROBE_NOW() - t0);
+	if (n < 0) {
+	    if (errno == EINTR)
+		continue;
+	    return -1;
+	}
+	while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+	    n -= iov->iov_len;
+	    iov->iov_len = 0;
+	    iov++;
+	    iovcnt--;
+	}
+	if (iovcnt > 0) {
+	    iov->iov_base = (char *)iov->iov_base + n;
+	    iov->iov_len -= n;
+	}
+    }
+
+    return 0;
+}
+
+/*
+ * Switch target file descriptor, flushing anything pending for the old one.
+ */
+static int
+OutputChannel_target(OutputChannel *oc, int fd)
+{
+    int retval = 0;
+
+    if (fd == oc->oc_fd)
+	return 0;
+
+    /* Output the old target did not take is dropped rather than sent to fd */
+    retval = OutputChannel_flush(oc);
+    oc->oc_len = 0;
+    if (oc->oc_file) {
+	Mem_untrack(MEM_FILE, oc->oc_file, sizeof(FILE));
+	fclose(oc->oc_file);	/* Closes our dup, not the caller's fd */
+	oc->oc_file = NULL;
+    }
+    oc->oc_fd = fd;
+
+    return retval;
+}
+
+OutputChannel *
+OutputChannel_new(void)
+{
+    OutputChannel *oc;
+
+    if ((oc = malloc(sizeof(*oc))) == NULL)
+	return NULL;
+    memset(oc, 0, sizeof(*oc));
+    oc->oc_fd = -1;
+
+    return oc;
+}
+
+void
+OutputChannel_free(OutputChannel *oc)
+{
+    if (oc == NULL)
+	return;
+
+    OutputChannel_flush(oc);
+    if (oc->oc_file) {
+	Mem_untrack(MEM_FILE, oc->oc_file, sizeof(FILE));
+	fclose(oc->oc_file);
+    }
+    Mem_untrack(MEM_OUTPUT, oc->oc_buf, OUTPUT_BUFSIZ);
+    free(oc->oc_buf);
+    Mem_untrack(MEM_OUTPUT, oc->oc_arena, oc->oc_arena_size);
+    free(oc->oc_arena);
+    free(oc);
+}
+
+/*
+ * Keep the part of the channel buffer described by iov, which a failed write
+ * left unwritten, for the next flush.
+ */
+static void
+OutputChannel_keep(OutputChannel *oc, struct iovec *iov)
+{
+    if (iov->iov_base != oc->oc_buf)
+	memmove(oc->oc_buf, iov->iov_base, iov->iov_len);
+    oc->oc_len = iov->iov_len;
+}
+
+/*
+ * Queue output for fd. Small writes are collected in the channel buffer, a
+ * write that does not fit is sent together with the pending data in one
+ * writev(2). If that fails, what was not written is kept pending when it
+ * fits in the buffer, otherwise only the pending data is and the new output
+ * fails.
+ */
+int
+OutputChannel_write(OutputChannel *oc, int fd, const char *buf, size_t len)
+{
+    struct iovec iov[2];
+
+    if (OutputChannel_target(oc, fd) < 0)
+	return -1;
+
+    if (oc->oc_buf == NULL) {
+	if ((oc->oc_buf = malloc(OUTPUT_BUFSIZ)) == NULL)
+	    return -1;
+	Mem_track(MEM_OUTPUT, oc->oc_buf, OUTPUT_BUFSIZ);
+    }
+
+    if (oc->oc_len + len <= OUTPUT_BUFSIZ) {
+	memcpy(oc->oc_buf + oc->oc_len, buf, len);
+	oc->oc_len += len;
+	oc->oc_bytes += len;
+	return 0;
+    }
+
+    iov[0].iov_base = oc->oc_buf;
+    iov[0].iov_len = oc->oc_len;
+    iov[1].iov_base = (void *)buf;
+    iov[1].iov_len = len;
+    oc->oc_bytes += len;
+
+    if (OutputChannel_writev(fd, iov, 2) < 0) {
+	OutputChannel_keep(oc, &iov[0]);
+	if (oc->oc_len + iov[1].iov_len > OUTPUT_BUFSIZ)
+	    return -1;
+	memcpy(oc->oc_buf + oc->oc_len, iov[1].iov_base, iov[1].iov_len);
+	oc->oc_len += iov[1].iov_len;
+	return 0;
+    }
+    oc->oc_len = 0;
+
+    return 0;
+}
+
+/*
+ * Write out all pending output. On error, such as EAGAIN on a non-blocking
+ * fd, the output not written stays pending.
+ */
+int
+OutputChannel_flush(OutputChannel *oc)
+{
+    struct iovec iov;
+
+    if (oc->oc_len == 0 || oc->oc_fd < 0)
+	return 0;
+
+    iov.iov_base = oc->oc_buf;
+    iov.iov_len = oc->oc_len;
+    if (OutputChannel_writev(oc->oc_fd, &iov, 1) < 0) {
+	OutputChannel_keep(oc, &iov);
+	return -1;
+    }
+    oc->oc_len = 0;
+
+    return 0;
+}
+
+/*
+ * Get a stream for fd to hand to cligen_output() when paging. Pending output
+ * is flushed first so ordering is kept. The stream is kept open on a dup of
+ * fd until the target changes or the channel is freed.
+ */
+static FILE *
+OutputChannel_file(OutputChannel *oc, int fd)
+{
+    int dupfd;
+
+    if (OutputChannel_target(oc, fd) < 0 || OutputChannel_flush(oc) < 0)
+	return NULL;
+
+    if (oc->oc_file == NULL) {
+	if ((dupfd = dup(fd)) < 0)
+	    return NULL;
+	if ((oc->oc_file = fdopen(dupfd, "a")) == NULL) {
+	    close(dupfd);
+	    return NULL;
+	}
+	Mem_track(MEM_FILE, oc->oc_file, sizeof(FILE));
+    }
+
+    return oc->oc_file;
+}
+
+/*
+ * Write output through the CLIgen pager, which honours terminalrows.
+ */
+int
+OutputChannel_page(OutputChannel *oc, int fd, const char *buf, size_t len)
+{
+    FILE *f;
+
+    if ((f = OutputChannel_file(oc, fd)) == NULL)
+	return -1;
+
+    cligen_output(f, "%.*s", (int)len, buf);
+    oc->oc_bytes += len;
+
+    return fflush(f);
+}
+
+/*
+ * Append output to the capture arena, doubling its size as needed
+ */
+static int
+OutputChannel_arena(OutputChannel *oc, const char *buf, size_t len)
+{
+    char *arena;
+    size_t size;
+
+    if (oc->oc_arena_len + len > oc->oc_arena_size) {
+	size = oc->oc_arena_size ? oc->oc_arena_size : OUTPUT_BUFSIZ;
+	while (size < oc->oc_arena_len + len)
+	    size *= 2;
+	if ((arena = realloc(oc->oc_arena, size)) == NULL) {
+	    PyErr_NoMemory();
+	    return -1;
+	}
+	Mem_untrack(MEM_OUTPUT, oc->oc_arena, oc->oc_arena_size);
+	Mem_track(MEM_OUTPUT, arena, size);
+	oc->oc_arena = arena;
+	oc->oc_arena_size = size;
+    }
+    memcpy(oc->oc_arena + oc->oc_arena_len, buf, len);
+    oc->oc_arena_len += len;
+
+    return 0;
+}
+
+/*
+ * Start capturing output. Returns a mark to pass to OutputChannel_capture_end()
+ * which returns the output captured since. Captures may be nested.
+ */
+size_t
+OutputChannel_capture_start(OutputChannel *oc)
+{
+    oc->oc_capture++;
+
+    return oc->oc_arena_len;
+}
+
+/*
+ * End a capture and return the output captured since 'mark' as a str
+ */
+PyObject *
+OutputChannel_capture_end(OutputChannel *oc, size_t mark)
+{
+    PyObject *str;
+
+    str = PyUnicode_DecodeUTF8(oc->oc_arena + mark, oc->oc_arena_len - mark,
+			       "replace");
+    oc->oc_arena_len = mark;
+    if (--oc->oc_capture == 0 && oc->oc_arena_size > OUTPUT_ARENA_MAX) {
+	Mem_untrack(MEM_OUTPUT, oc->oc_arena, oc->oc_arena_size);
+	free(oc->oc_arena);
+	oc->oc_arena = NULL;
+	oc->oc_arena_size = 0;
+    }
+
+    return str;
+}
+
+/*
+ * Start paging a stream of output with 'rows' lines per page. A 'rows'
+ * of 0 disables paging.
+ */
+void
+OutputChannel_pager_start(OutputChannel *oc, int rows)
+{
+    oc->oc_rows = rows;
+    oc->oc_lines = 0;
+    oc->oc_tty = -1;
+}
+
+/*
+ * Prompt "--More--" and wait for a key from the terminal. Space shows the
+ * next page, return the next line and 'q' quits.
+ *
+ * Returns 1 if the user quits, 0 to continue or -1 on error.
+ */
+static int
+OutputChannel_more(OutputChannel *oc, int fd)
+{
+    static char more[] = "--More--";
+    static char erase[] = "\r        \r";
+    struct iovec iov;
+    struct termios t;
+    struct termios raw;
+    unsigned char c = 'q';
+    ssize_t n = 0;
+    int term = 0;
+
+    if (OutputChannel_flush(oc) < 0)
+	return -1;
+    iov.iov_base = more;
+    iov.iov_len = sizeof(more) - 1;
+    if (OutputChannel_writev(fd, &iov, 1) < 0)
+	return -1;
+
+    Py_BEGIN_ALLOW_THREADS
+    if (tcgetattr(STDIN_FILENO, &t) == 0) {
+	term = 1;
+	raw = t;
+	raw.c_lflag &= ~(ICANON | ECHO);
+	raw.c_cc[VMIN] = 1;
+	raw.c_cc[VTIME] = 0;
+	tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+	do
+	    n = read(STDIN_FILENO, &c, 1);
+	while (n < 0 && errno == EINTR);
+	tcsetattr(STDIN_FILENO, TCSANOW, &t);
+    }
+    Py_END_ALLOW_THREADS
+
+    iov.iov_base = erase;
+    iov.iov_len = sizeof(erase) - 1;
+    if (OutputChannel_writev(fd, &iov, 1) < 0)
+	return -1;
+
+    if (!term) {
+	/* No terminal to read an answer from, stop paging */
+	oc->oc_tty = 0;
+	return 0;
+    }
+    if (n != 1 || c == 'q' || c == 'Q')
+	return 1;
+    if (c == '\r' || c == '\n')
+	oc->oc_lines = oc->oc_rows - 1;
+    else
+	oc->oc_lines = 0;
+
+    return 0;
+}
+
+/*
+ * Write streamed output line by line, prompting between pages. Output is
+ * flushed after each write so each chunk shows as soon as it is produced.
+ *
+ * Returns 1 if the user quit the pager, 0 on success or -1 on error.
+ */
+static int
+OutputChannel_pager(OutputChannel *oc, int fd, const char *buf, size_t len)
+{
+    int ret;
+    size_t n;
+    const char *nl;
+
+    /* Paging needs a terminal on both ends to show and answer the prompt */
+    if (oc->oc_tty < 0)
+	oc->oc_tty = isatty(fd) && isatty(STDIN_FILENO);
+    if (!oc->oc_tty || oc->oc_rows <= 1)
+	return OutputChannel_write(oc, fd, buf, len);
+
+    while (len > 0) {
+	if (!oc->oc_tty)
+	    return OutputChannel_write(oc, fd, buf, len) < 0 ? -1 :
+		OutputChannel_flush(oc);
+	if (oc->oc_lines >= oc->oc_rows - 1 &&
+	    (ret = OutputChannel_more(oc, fd)) != 0)
+	    return ret;
+	nl = memchr(buf, '\n', len);
+	n = nl ? (size_t)(nl - buf) + 1 : len;
+	if (OutputChannel_write(oc, fd, buf, n) < 0)
+	    return -1;
+	if (nl)
+	    oc->oc_lines++;
+	buf += n;
+	len -= n;
+    }
+
+    return OutputChannel_flush(oc);
+}
+
+/*
+ * Get file descriptor of a file-like object. Returns -1 without an exception
+ * set if the object has no usable descriptor, such as io.StringIO.
+ */
+static int
+OutputChannel_fileno(PyObject *file)
+{
+    int fd;
+    PyObject *fileno;
+
+    if (!PyObject_HasAttrString(file, "fileno"))
+	return -1;
+
+    if ((fileno = PyObject_CallMethod(file, "fileno", NULL)) == NULL) {
+	if (PyErr_ExceptionMatches(PyExc_AttributeError) ||
+	    PyErr_ExceptionMatches(PyExc_OSError))
+	    PyErr_Clear();
+	return -1;
+    }
+    fd = PyLong_AsLong(fileno);
+    Py_DECREF(fileno);
+
+    return fd;
+}
+
+/*
+ * Append output to a bytearray, growing it in place
+ */
+static int
+OutputChannel_bytearray(PyObject *file, const char *buf, size_t len)
+{
+    Py_ssize_t size = PyByteArray_GET_SIZE(file);
+
+    if (PyByteArray_Resize(file, size + len) < 0)
+	return -1;
+    memcpy(PyByteArray_AS_STRING(file) + size, buf, len);
+
+    return 0;
+}
+
+/*
+ * Write output to a binary file-like object. The io classes known not to
+ * keep what they are passed get a memoryview of the output, released when
+ * write() returns, others a bytes copy.
+ */
+static int
+OutputChannel_binary(PyObject *file, const char *buf, size_t len)
+{
+    size_t i;
+    PyObject *data;
+    PyObject *ret;
+    PyObject *rel;
+    PyObject *type, *value, *tb;
+
+    for (i = 0; i < IO_COPYING; i++)
+	if (Py_TYPE(file) == (PyTypeObject *)io_copying[i])
+	    break;
+    if (i < IO_COPYING)
+	data = PyMemoryView_FromMemory((char *)buf, len, PyBUF_READ);
+    else
+	data = PyBytes_FromStringAndSize(buf, len);
+    if (data == NULL)
+	return -1;
+
+    ret = PyObject_CallMethod(file, "write", "O", data);
+    if (i < IO_COPYING) {
+	/* Fails if write() kept an export of the view */
+	PyErr_Fetch(&type, &value, &tb);
+	rel = PyObject_CallMethod(data, "release", NULL);
+	if (rel == NULL)
+	    Py_CLEAR(ret);
+	if (type != NULL) {
+	    PyErr_Clear();
+	    PyErr_Restore(type, value, tb);
+	}
+	Py_XDECREF(rel);
+    }
+    Py_DECREF(data);
+    if (ret == NULL)
+	return -1;
+    Py_DECREF(ret);
+
+    return 0;
+}
+
+/*
+ * Write output to a text file-like object, such as io.StringIO
+ */
+static int
+OutputChannel_text(PyObject *file, PyObject *out, const char *buf, size_t len)
+{
+    PyObject *str;
+    PyObject *ret;
+
+    if (PyUnicode_Check(out)) {
+	Py_INCREF(out);
+	str = out;
+    } else if ((str = PyUnicode_DecodeUTF8(buf, len, "replace")) == NULL)
+	return -1;
+
+    ret = PyObject_CallMethod(file, "write", "O", str);
+    Py_DECREF(str);
+    if (ret == NULL)
+	return -1;
+    Py_DECREF(ret);
+
+    return 0;
+}
+
+/*
+ * Write 'out', a str or an object supporting the buffer protocol, to 'file'.
+ *
+ * The target can be a bytearray, which is appended to directly, a binary
+ * file-like object such as io.BytesIO, an object with a file descriptor, in
+ * which case output is buffered by the channel and optionally paged, or any
+ * other object with a write() method, which is passed a str. While a capture
+ * is active the output is appended to the capture arena instead.
+ *
+ * Output to a file descriptor is paged according to 'paging', which is one
+ * of OUTPUT_NOPAGE, OUTPUT_PAGE or OUTPUT_PAGE_STREAM.
+ *
+ * Returns 0 on success, 1 if the user quit the stream pager, or -1 with a
+ * Python exception set.
+ */
+int
+OutputChannel_output(OutputChannel *oc, PyObject *file, PyObject *out, int paging)
+{
+    int fd;
+    int retval = -1;
+    const char *buf;
+    Py_ssize_t len;
+    Py_buffer view;
+
+    view.obj = NULL;
+    if (PyUnicode_Check(out)) {
+	if ((buf = PyUnicode_AsUTF8AndSize(out, &len)) == NULL)
+	    return -1;
+    } else {
+	if (PyObject_GetBuffer(out, &view, PyBUF_SIMPLE) < 0)
+	    return -1;
+	buf = view.buf;
+	len = view.len;
+    }
+
+    if (OutputChannel_io_init() < 0)
+	goto done;
+
+    if (oc->oc_capture)
+	retval = OutputChannel_arena(oc, buf, len);
+
+    else if (PyByteArray_Check(file))
+	retval = OutputChannel_bytearray(file, buf, len);
+
+    else if (PyObject_IsInstance(file, io_BytesIO) == 1 ||
+	     PyObject_IsInstance(file, io_BufferedIOBase) == 1 ||
+	     PyObject_IsInstance(file, io_RawIOBase) == 1)
+	retval = OutputChannel_binary(file, buf, len);
+
+    else if ((fd = OutputChannel_fileno(file)) >= 0) {
+	if (paging == OUTPUT_PAGE_STREAM)
+	    retval = OutputChannel_pager(oc, fd, buf, len);
+	else if (paging == OUTPUT_PAGE)
+	    retval = OutputChannel_page(oc, fd, buf, len);
+	else
+	    retval = OutputChannel_write(oc, fd, buf, len);
+	if (retval < 0)
+	    PyErr_SetFromErrno(PyExc_IOError);
+	goto done;	/* bytes already accounted for */
+    }
+
+    else if (PyErr_Occurred())
+	goto done;
+
+    else if (PyObject_HasAttrString(file, "write"))
+	retval = OutputChannel_text(file, out, buf, len);
+
+    else
+	PyErr_SetString(PyExc_TypeError,
+			"output target must be a bytearray or file-like object");
+
+    if (retval == 0)
+	oc->oc_bytes += len;
+
+done:
+    if (view.obj)
+	PyBuffer_Release(&view);
+
+    return retval;
+}
+
+uint64_t
+OutputChannel_bytes(OutputChannel *oc)
+{
+    return oc->oc_bytes;
+}
@@ -0,0 +1,79 @@
+/*
+ * pycligen_output.h
+ *
+ * Copyright (C) 2014-2015 Benny Holmgren
+ *
+ * This file is part of PyCLIgen.
+ *
+ * PyCLIgen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ *  PyCLIgen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along wth PyCLIgen; see the file LICENSE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PY_CLIGEN_OUTPUT_H_
+#define _PY_CLIGEN_OUTPUT_H_
+
+#include <stdint.h>
+
+#define OUTPUT_BUFSIZ  (64 * 1024)
+#define OUTPUT_ARENA_MAX  (4 * 1024 * 1024)  /* Larger arenas are released */
+
+/* Paging modes for OutputChannel_output() */
+#define OUTPUT_NOPAGE       0  /* Write output as is */
+#define OUTPUT_PAGE         1  /* Page each write with cligen_output() */
+#define OUTPUT_PAGE_STREAM  2  /* Page a stream of writes, see below */
+
+/*
+ * Output channel. Each CLIgen instance owns one, and all output made via
+ * CLIgen.output() is routed through it. Output is collected in oc_buf and
+ * written with writev(2) when the buffer fills up, when the target changes,
+ * when the pager needs the stream or when a command has completed.
+ *
+ * While a capture is active all output, whatever its target, is instead
+ * appended to oc_arena. The arena is reused between commands so capturing
+ * the output of many commands does not allocate per command.
+ *
+ * Output streamed from a callback iterator is paged by the channel itself,
+ * counting lines across writes and prompting "--More--" every oc_rows lines
+ * so the caller can stop pulling output when the user quits the pager.
+ */
+typedef struct {
+    int       oc_fd;     /* Current target file descriptor, -1 if none */
+    FILE     *oc_file;   /* Stream on a dup of oc_fd, used by the pager */
+    char     *oc_buf;    /* Pending output */
+    size_t    oc_len;    /* Number of bytes pending in oc_buf */
+    uint64_t  oc_bytes;  /* Total number of bytes written */
+    int       oc_capture;     /* Capture nesting depth, 0 if not capturing */
+    char     *oc_arena;       /* Captured output */
+    size_t    oc_arena_len;   /* Number of bytes captured */
+    size_t    oc_arena_size;  /* Size of oc_arena */
+    int       oc_rows;   /* Stream pager rows, 0 if not paging */
+    int       oc_lines;  /* Lines written since last pager prompt */
+    int       oc_tty;    /* Stream and stdin are terminals, -1 if not known */
+} OutputChannel;
+
+OutputChannel *OutputChannel_new(void);
+void OutputChannel_free(OutputChannel *oc);
+
+int OutputChannel_write(OutputChannel *oc, int fd, const char *buf, size_t len);
+int OutputChannel_flush(OutputChannel *oc);
+int OutputChannel_page(OutputChannel *oc, int fd, const char *buf, size_t len);
+int OutputChannel_output(OutputChannel *oc, PyObject *file, PyObject *out, int paging);
+uint64_t OutputChannel_bytes(OutputChannel *oc);
+
+void OutputChannel_pager_start(OutputChannel *oc, int rows);
+
+size_t OutputChannel_capture_start(OutputChannel *oc);
+PyObject *OutputChannel_capture_end(OutputChannel *oc, size_t mark);
+
+#endif /* _PY_CLIGEN_OUTPUT_H_ */
@@ -0,0 +1,75 @@
+/*
+ * pycligen_probes.h
+ *
+ * Copyright (C) 2014-2015 Benny Holmgren
+ *
+ * This file is part of PyCLIgen.
+ *
+ * PyCLIgen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ *  PyCLIgen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along wth PyCLIgen; see the file LICENSE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PY_CLIGEN_PROBES_H_
+#define _PY_CLIGEN_PROBES_H_
+
+/*
+ * USDT probes of provider "pycligen", compiled in when built with
+ * --enable-usdt, or PYCLIGEN_USDT=1 set for setup.py. A probe is a nop until
+ * a tracer such as bpftrace or perf attaches to it. Durations are in ns.
+ *
+ *   match(line, retval, ns)             line matched, retval as cliread_parse()
+ *   callback__entry(name)               command callback called
+ *   callback__return(name, retval, ns)  command callback returned
+ *   expand__entry(name)                 expand callback called
+ *   expand__return(name, retval, ns)    expand callback returned
+ *   output__write(fd, len, ns)          output written
+ *
+ * Example:
+ *   bpftrace -e 'usdt:./_cligen.so:pycligen:callback__return
+ *                { @[str(arg0)] = hist(arg2); }'
+ */
+#ifdef PYCLIGEN_USDT
+
+#include <sys/sdt.h>
+
+#include "pycligen_stats.h"
+
+#define PROBE_NOW()  Stats_now()
+
+#define PROBE_MATCH(line, retval, ns) \
+    DTRACE_PROBE3(pycligen, match, line, retval, ns)
+#define PROBE_CALLBACK_ENTRY(name) \
+    DTRACE_PROBE1(pycligen, callback__entry, name)
+#define PROBE_CALLBACK_RETURN(name, retval, ns) \
+    DTRACE_PROBE3(pycligen, callback__return, name, retval, ns)
+#define PROBE_EXPAND_ENTRY(name) \
+    DTRACE_PROBE1(pycligen, expand__entry, name)
+#define PROBE_EXPAND_RETURN(name, retval, ns) \
+    DTRACE_PROBE3(pycligen, expand__return, name, retval, ns)
+#define PROBE_OUTPUT_WRITE(fd, len, ns) \
+    DTRACE_PROBE3(pycligen, output__write, fd, len, ns)
+
+#else /* PYCLIGEN_USDT */
+
+#define PROBE_NOW()  0
+#define PROBE_MATCH(line, retval, ns)
+#define PROBE_CALLBACK_ENTRY(name)
+#define PROBE_CALLBACK_RETURN(name, retval, ns)  ((void)(ns))
+#define PROBE_EXPAND_ENTRY(name)
+#define PROBE_EXPAND_RETURN(name, retval, ns)    ((void)(ns))
+#define PROBE_OUTPUT_WRITE(fd, len, ns)          ((void)(ns))
+
+#endif /* PYCLIGEN_USDT */
+
+#endif /* _PY_CLIGEN_PROBES_H_ */
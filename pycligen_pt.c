@@ -20,24 +20,28 @@
  * <http://www.gnu.org/licenses/>.
  */
 
+#define PY_SSIZE_T_CLEAN
 #include <Python.h>
 
 #include <cligen/cligen.h>
 
 #include "pycligen.h"
+#include "pycligen_mem.h"
 
 typedef struct {
     PyObject_HEAD
     parse_tree pt;
     char *name;      /* Name of ParseTree, set by _cligen.tree_add() */
     PyObject *globals;
+    PyObject *hits;  /* Matches per command, see ParseTree_hit() */
 } ParseTree;
 
 static void
 ParseTree_dealloc(ParseTree* self)
 {
-    /* Free parse_tree ??? */
+    /* Free parse_tree ??? Until then it stays tracked as MEM_PARSETREE */
     Py_XDECREF(self->globals);
+    Py_XDECREF(self->hits);
     free(self->name);
     Py_TYPE(self)->tp_free((PyObject*)self);
 }
@@ -48,6 +52,28 @@ ParseTree_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
     return (PyObject *)type->tp_alloc(type, 0);
 }
 
+/*
+ * Estimate the memory of a parse tree from its nodes and keywords
+ */
+static size_t
+ParseTree_size(parse_tree *pt)
+{
+    int i;
+    size_t size;
+    cg_obj *co;
+
+    size = pt->pt_len * sizeof(cg_obj *);
+    for (i = 0; i < pt->pt_len; i++) {
+	if ((co = pt->pt_vec[i]) == NULL)
+	    continue;
+	size += sizeof(*co) + ParseTree_size(&co->co_pt);
+	if (co->co_command)
+	    size += strlen(co->co_command) + 1;
+    }
+
+    return size;
+}
+
 static int
 ParseTree_init(ParseTree *self, PyObject *args, PyObject *kwds)
 {
@@ -73,6 +99,9 @@ ParseTree_init(ParseTree *self, PyObject *args, PyObject *kwds)
     
     if ((self->globals = PyDict_New()) == NULL)
 	goto done;
+    Py_XDECREF(self->hits);
+    if ((self->hits = PyDict_New()) == NULL)
+	goto done;
     
     if (syntax != NULL) {
 	if (cligen_parse_str(CLIgen_cligen_handle(cgen),
@@ -118,6 +147,7 @@ ParseTree_init(ParseTree *self, PyObject *args, PyObject *kwds)
 	    goto done;
     }
     
+    Mem_track(MEM_PARSETREE, self->pt.pt_vec, ParseTree_size(&self->pt));
     retval = 0;
 
 done:
@@ -166,6 +196,84 @@ ParseTree_repr(PyObject *self)
     return str;    
 }
 
+/*
+ * Token of a parse-tree node as written in the syntax: the keyword, 
+ * <name:type> for a variable or @tree for a tree reference.
+ */
+static PyObject *
+ParseTree_token(cg_obj *co)
+{
+    char *cmd = co->co_command ? co->co_command : "";
+
+    switch (co->co_type) {
+    case CO_VARIABLE:
+	return PyUnicode_FromFormat("<%s:%s>", cmd, cv_type2str(co->co_vtype));
+    case CO_REFERENCE:
+	return PyUnicode_FromFormat("@%s", cmd);
+    default:
+	return StringFromString(cmd);
+    }
+}
+
+/*
+ * Add the nodes of pt and below, in syntax order, to List as tuples
+ * (depth, token, callback name or None).
+ */
+static int
+ParseTree_nodes_add(PyObject *List, parse_tree *pt, int depth)
+{
+    int i;
+    int ret;
+    cg_obj *co;
+    PyObject *Node;
+
+    for (i = 0; i < pt->pt_len; i++) {
+	if ((co = pt->pt_vec[i]) == NULL)
+	    continue;
+	if (co->co_callbacks && co->co_callbacks->cc_fn_str)
+	    Node = Py_BuildValue("(iNs)", depth, ParseTree_token(co), 
+				 co->co_callbacks->cc_fn_str);
+	else
+	    Node = Py_BuildValue("(iNO)", depth, ParseTree_token(co), Py_None);
+	if (Node == NULL)
+	    return -1;
+	ret = PyList_Append(List, Node);
+	Py_DECREF(Node);
+	if (ret < 0 || ParseTree_nodes_add(List, &co->co_pt, depth + 1) < 0)
+	    return -1;
+    }
+
+    return 0;
+}
+
+static PyObject *
+_ParseTree_nodes(ParseTree *self)
+{
+    PyObject *List;
+
+    if ((List = PyList_New(0)) == NULL)
+	return NULL;
+    if (ParseTree_nodes_add(List, &self->pt, 0) < 0) {
+	Py_DECREF(List);
+	return NULL;
+    }
+
+    return List;
+}
+
+static PyObject *
+_ParseTree_hits(ParseTree *self)
+{
+    return PyDict_Copy(self->hits);
+}
+
+static PyObject *
+ParseTree_coverage_reset(ParseTree *self)
+{
+    PyDict_Clear(self->hits);
+    Py_RETURN_NONE;
+}
+
 #if 0
 static PyObject *
 ParseTree_fprint(ParseTree *self, PyObject *args)
@@ -202,6 +310,18 @@ static PyMethodDef ParseTree_methods[] = {
      "Get dictionary of ParseTree global variables"
     },
 
+    {"_nodes", (PyCFunction)_ParseTree_nodes, METH_NOARGS, 
+     "Get list of parse-tree nodes in syntax order"
+    },
+
+    {"_hits", (PyCFunction)_ParseTree_hits, METH_NOARGS, 
+     "Get dictionary of matches per command"
+    },
+
+    {"coverage_reset", (PyCFunction)ParseTree_coverage_reset, METH_NOARGS, 
+     "Reset match counters"
+    },
+
 #if 0
     {"print", (PyCFunction)ParseTree_fprint, METH_VARARGS, 
      "Print CLIgen parse-tree to file, brief or detailed."
@@ -304,3 +424,46 @@ ParseTree_name(PyObject *obj)
     
     return Pt->name;
 }
+
+/*
+ * Count a match. Matches are counted per command, keyed by the tuple of
+ * tokens from the top of the tree down to the matched node. Keying on tokens
+ * rather than nodes also counts commands matched via expanded tree references.
+ */
+int
+ParseTree_hit(PyObject *obj, cg_obj *match)
+{
+    int i;
+    int n;
+    int ret = -1;
+    cg_obj *co;
+    ParseTree *Pt = (ParseTree *)obj;
+    PyObject *Key = NULL;
+    PyObject *Token;
+    PyObject *Hits;
+
+    for (n = 0, co = match; co; co = co->co_prev)
+	n++;
+    if ((Key = PyTuple_New(n)) == NULL)
+	return -1;
+    for (i = n - 1, co = match; co; co = co->co_prev, i--) {
+	if ((Token = ParseTree_token(co)) == NULL)
+	    goto done;
+	PyTuple_SET_ITEM(Key, i, Token);
+    }
+
+    if ((Hits = PyDict_GetItemWithError(Pt->hits, Key)) == NULL) {
+	if (PyErr_Occurred())
+	    goto done;
+	Hits = PyLong_FromLong(1);
+    } else
+	Hits = PyLong_FromUnsignedLongLong(PyLong_AsUnsignedLongLong(Hits) + 1);
+    if (Hits == NULL)
+	goto done;
+    ret = PyDict_SetItem(Pt->hits, Key, Hits);
+    Py_DECREF(Hits);
+
+done:
+    Py_XDECREF(Key);
+    return ret;
+}
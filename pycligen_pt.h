@@ -31,5 +31,6 @@ parse_tree *ParseTree_pt(PyObject *pto);
 
 int ParseTree_name_set(PyObject *obj, const char *name);
 char *ParseTree_name(PyObject *obj);
+int ParseTree_hit(PyObject *obj, cg_obj *match);
 
 #endif /* _PY_CLIGEN_PT_H_ */
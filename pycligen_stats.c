@@ -0,0 +1,226 @@
+/*
+ * pycligen_stats.c
+ *
+ * Copyright (C) 2014-2015 Benny Holmgren
+ *
+ * This file is part of PyCLIgen.
+ *
+ * PyCLIgen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ *  PyCLIgen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along wth PyCLIgen; see the file LICENSE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <time.h>
+
+#include "pycligen_stats.h"
+#include "pycligen_mem.h"
+
+static const char *Stats_phases[STATS_NPHASES] = {
+    "match", "convert", "callback"
+};
+
+
+Stats *
+Stats_new(void)
+{
+    Stats *st;
+
+    if ((st = malloc(sizeof(*st))) == NULL)
+	return NULL;
+    memset(st, 0, sizeof(*st));
+    Mem_track(MEM_STATS, st, sizeof(*st));
+
+    return st;
+}
+
+/*
+ * Drop all entries
+ */
+void
+Stats_reset(Stats *st)
+{
+    int i;
+    StatsEntry *se;
+
+    for (i = 0; i < STATS_HASHSIZE; i++) {
+	while ((se = st->st_table[i]) != NULL) {
+	    st->st_table[i] = se->se_next;
+	    Mem_untrack(MEM_STATS, se, sizeof(*se) +
+			(se->se_name ? strlen(se->se_name) + 1 : 0));
+	    free(se->se_name);
+	    free(se);
+	}
+    }
+}
+
+void
+Stats_free(Stats *st)
+{
+    if (st == NULL)
+	return;
+
+    Stats_reset(st);
+    Mem_untrack(MEM_STATS, st, sizeof(*st));
+    free(st);
+}
+
+/*
+ * Current time in ns, from the vDSO monotonic clock
+ */
+uint64_t
+Stats_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * Get the entry of a callback, name NULL for none, creating it if needed.
+ * Returns NULL if out of memory.
+ */
+StatsEntry *
+Stats_entry(Stats *st, const char *name)
+{
+    uint32_t hash = 2166136261u;
+    const char *p;
+    StatsEntry *se;
+    StatsEntry **head;
+
+    for (p = name; p && *p; p++)
+	hash = (hash ^ (unsigned char)*p) * 16777619u;
+    head = &st->st_table[hash % STATS_HASHSIZE];
+
+    for (se = *head; se; se = se->se_next)
+	if (name ? (se->se_name && strcmp(se->se_name, name) == 0) : 
+	    se->se_name == NULL)
+	    return se;
+
+    if ((se = malloc(sizeof(*se))) == NULL)
+	return NULL;
+    memset(se, 0, sizeof(*se));
+    if (name && (se->se_name = strdup(name)) == NULL) {
+	free(se);
+	return NULL;
+    }
+    se->se_next = *head;
+    *head = se;
+    Mem_track(MEM_STATS, se, sizeof(*se) + (name ? strlen(name) + 1 : 0));
+
+    return se;
+}
+
+void
+Stats_record(StatsEntry *se, int phase, uint64_t ns)
+{
+    int b;
+    Histogram *h = &se->se_hist[phase];
+
+    b = ns ? 63 - __builtin_clzll(ns) : 0;
+    if (b >= STATS_BUCKETS)
+	b = STATS_BUCKETS - 1;
+    h->h_buckets[b]++;
+    if (h->h_count == 0 || ns < h->h_min)
+	h->h_min = ns;
+    if (ns > h->h_max)
+	h->h_max = ns;
+    h->h_sum += ns;
+    h->h_count++;
+}
+
+static PyObject *
+Stats_hist_dict(Histogram *h)
+{
+    int i;
+    int n;
+    PyObject *Buckets;
+    PyObject *Count;
+
+    for (n = STATS_BUCKETS; n > 0 && h->h_buckets[n - 1] == 0; n--)
+	;
+    if ((Buckets = PyList_New(n)) == NULL)
+	return NULL;
+    for (i = 0; i < n; i++) {
+	if ((Count = PyLong_FromUnsignedLongLong(h->h_buckets[i])) == NULL) {
+	    Py_DECREF(Buckets);
+	    return NULL;
+	}
+	PyList_SET_ITEM(Buckets, i, Count);
+    }
+
+    return Py_BuildValue("{sKsKsKsKsN}",
+			 "count", (unsigned long long)h->h_count,
+			 "total", (unsigned long long)h->h_sum,
+			 "min", (unsigned long long)h->h_min,
+			 "max", (unsigned long long)h->h_max,
+			 "buckets", Buckets);
+}
+
+/*
+ * Get the statistics as a dict, see CLIgen.stats()
+ */
+PyObject *
+Stats_dict(Stats *st)
+{
+    int i;
+    int phase;
+    int ret;
+    StatsEntry *se;
+    PyObject *Dict;
+    PyObject *Phases;
+    PyObject *Hist;
+    PyObject *Name;
+
+    if ((Dict = PyDict_New()) == NULL)
+	return NULL;
+
+    for (i = 0; i < STATS_HASHSIZE; i++) {
+	for (se = st->st_table[i]; se; se = se->se_next) {
+	    if ((Phases = PyDict_New()) == NULL)
+		goto fail;
+	    for (phase = 0; phase < STATS_NPHASES; phase++) {
+		if ((Hist = Stats_hist_dict(&se->se_hist[phase])) == NULL) {
+		    Py_DECREF(Phases);
+		    goto fail;
+		}
+		ret = PyDict_SetItemString(Phases, Stats_phases[phase], Hist);
+		Py_DECREF(Hist);
+		if (ret < 0) {
+		    Py_DECREF(Phases);
+		    goto fail;
+		}
+	    }
+	    if (se->se_name)
+		Name = PyUnicode_FromString(se->se_name);
+	    else {
+		Py_INCREF(Py_None);
+		Name = Py_None;
+	    }
+	    ret = Name ? PyDict_SetItem(Dict, Name, Phases) : -1;
+	    Py_XDECREF(Name);
+	    Py_DECREF(Phases);
+	    if (ret < 0)
+		goto fail;
+	}
+    }
+
+    return Dict;
+
+fail:
+    Py_DECREF(Dict);
+    return NULL;
+}
@@ -0,0 +1,76 @@
+/*
+ * pycligen_stats.h
+ *
+ * Copyright (C) 2014-2015 Benny Holmgren
+ *
+ * This file is part of PyCLIgen.
+ *
+ * PyCLIgen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ *  PyCLIgen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along wth PyCLIgen; see the file LICENSE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PY_CLIGEN_STATS_H_
+#define _PY_CLIGEN_STATS_H_
+
+#include <stdint.h>
+
+#define STATS_BUCKETS   48   /* Latency buckets, the last one up to ~39 hours */
+#define STATS_HASHSIZE  64   /* Callback name hash table size */
+
+/* Phases of a command */
+#define STATS_MATCH     0    /* Matching the line in libcligen */
+#define STATS_CONVERT   1    /* Building the Cvec and argument CgVar */
+#define STATS_CALLBACK  2    /* Running the Python callback and its output */
+#define STATS_NPHASES   3
+
+/*
+ * Latency histogram. Bucket i counts latencies of [2^i, 2^(i+1)) ns, bucket
+ * 0 also those below 1 ns.
+ */
+typedef struct {
+    uint64_t  h_count;
+    uint64_t  h_sum;     /* Total ns */
+    uint64_t  h_min;
+    uint64_t  h_max;
+    uint64_t  h_buckets[STATS_BUCKETS];
+} Histogram;
+
+/*
+ * Histograms of each phase for commands with the same callback. Matching
+ * time of lines without a callback to run is kept in an entry without name.
+ */
+typedef struct StatsEntry {
+    struct StatsEntry *se_next;
+    char              *se_name;   /* Callback name, NULL for none */
+    Histogram          se_hist[STATS_NPHASES];
+} StatsEntry;
+
+/*
+ * Command latency statistics of a CLIgen instance, always collected. The
+ * entries are kept in a hash table on callback name.
+ */
+typedef struct {
+    StatsEntry *st_table[STATS_HASHSIZE];
+} Stats;
+
+Stats *Stats_new(void);
+void Stats_free(Stats *st);
+void Stats_reset(Stats *st);
+
+uint64_t Stats_now(void);
+StatsEntry *Stats_entry(Stats *st, const char *name);
+void Stats_record(StatsEntry *se, int phase, uint64_t ns);
+PyObject *Stats_dict(Stats *st);
+
+#endif /* _PY_CLIGEN_STATS_H_ */
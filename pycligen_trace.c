@@ -0,0 +1,131 @@
+/*
+ * pycligen_trace.c
+ *
+ * Copyright (C) 2014-2015 Benny Holmgren
+ *
+ * This file is part of PyCLIgen.
+ *
+ * PyCLIgen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ *  PyCLIgen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along wth PyCLIgen; see the file LICENSE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "pycligen_stats.h"
+#include "pycligen_trace.h"
+#include "pycligen_mem.h"
+
+static const char *Trace_cats[] = {
+    "line", "callback", "expand", "flush"
+};
+
+
+/*
+ * Create a tracer holding at least size events, naming line events after
+ * the command line if lines is set
+ */
+Trace *
+Trace_new(size_t size, int lines)
+{
+    size_t n;
+    Trace *tr;
+
+    for (n = 1; n < size; n <<= 1)
+	;
+    if ((tr = malloc(sizeof(*tr))) == NULL)
+	return NULL;
+    memset(tr, 0, sizeof(*tr));
+    if ((tr->tr_ring = calloc(n, sizeof(TraceEvent))) == NULL) {
+	free(tr);
+	return NULL;
+    }
+    tr->tr_size = n;
+    tr->tr_on = 1;
+    tr->tr_lines = lines;
+    Mem_track(MEM_TRACE, tr, sizeof(*tr) + n * sizeof(TraceEvent));
+
+    return tr;
+}
+
+void
+Trace_free(Trace *tr)
+{
+    if (tr == NULL)
+	return;
+
+    Mem_untrack(MEM_TRACE, tr, sizeof(*tr) + tr->tr_size * sizeof(TraceEvent));
+    free(tr->tr_ring);
+    free(tr);
+}
+
+/*
+ * Record an event. Must be called with the GIL held.
+ */
+void
+Trace_event(Trace *tr, int cat, char ph, const char *name)
+{
+    TraceEvent *te;
+
+    if (cat == TRACE_LINE && !tr->tr_lines)
+	name = "line";
+    te = &tr->tr_ring[tr->tr_head++ & (tr->tr_size - 1)];
+    te->te_ts = Stats_now();
+#ifdef SYS_gettid
+    te->te_tid = syscall(SYS_gettid);
+#endif
+    te->te_ph = ph;
+    te->te_cat = cat;
+    strncpy(te->te_name, name ? name : "", TRACE_NAMELEN - 1);
+    te->te_name[TRACE_NAMELEN - 1] = '\0';
+}
+
+/*
+ * Get the recorded events, oldest first, as a list of tuples
+ * (ts, ph, cat, tid, name), see CLIgen.trace_dump()
+ */
+PyObject *
+Trace_list(Trace *tr)
+{
+    uint64_t i;
+    uint64_t head;
+    TraceEvent *te;
+    PyObject *Ev;
+    PyObject *List;
+
+    if ((List = PyList_New(0)) == NULL)
+	return NULL;
+    if (tr == NULL)
+	return List;
+
+    head = tr->tr_head;
+    for (i = (head > tr->tr_size) ? head - tr->tr_size : 0; i < head; i++) {
+	te = &tr->tr_ring[i & (tr->tr_size - 1)];
+	Ev = Py_BuildValue("(KCsIN)", (unsigned long long)te->te_ts, te->te_ph,
+			   Trace_cats[(int)te->te_cat], te->te_tid,
+			   PyUnicode_DecodeUTF8(te->te_name, strlen(te->te_name),
+						"replace"));
+	if (Ev == NULL || PyList_Append(List, Ev) < 0) {
+	    Py_XDECREF(Ev);
+	    Py_DECREF(List);
+	    return NULL;
+	}
+	Py_DECREF(Ev);
+    }
+
+    return List;
+}
@@ -0,0 +1,67 @@
+/*
+ * pycligen_trace.h
+ *
+ * Copyright (C) 2014-2015 Benny Holmgren
+ *
+ * This file is part of PyCLIgen.
+ *
+ * PyCLIgen is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ *  PyCLIgen is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along wth PyCLIgen; see the file LICENSE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PY_CLIGEN_TRACE_H_
+#define _PY_CLIGEN_TRACE_H_
+
+#include <stdint.h>
+
+#define TRACE_NAMELEN   64   /* Event names are truncated to fit */
+
+/* Event categories */
+#define TRACE_LINE      0    /* Command line, from match to callback done */
+#define TRACE_CALLBACK  1    /* Command callback */
+#define TRACE_EXPAND    2    /* Expand callback */
+#define TRACE_FLUSH     3    /* Output flush */
+
+typedef struct {
+    uint64_t  te_ts;     /* CLOCK_MONOTONIC ns, as Stats_now() */
+    uint32_t  te_tid;    /* Kernel thread id */
+    char      te_ph;     /* 'B' or 'E' */
+    char      te_cat;
+    char      te_name[TRACE_NAMELEN];
+} TraceEvent;
+
+/*
+ * Event tracer. Begin and end events are written to a ring buffer, where
+ * they overwrite the oldest events once it is full. The ring is protected by
+ * the GIL: events are only recorded, and read, while holding it.
+ * Line events are named after the command line only if tr_lines is set,
+ * since lines may hold secrets. Otherwise they are named "line".
+ */
+typedef struct {
+    TraceEvent *tr_ring;
+    size_t      tr_size;    /* Number of slots, a power of two */
+    uint64_t    tr_head;    /* Number of events written */
+    int         tr_on;      /* Recording */
+    int         tr_lines;   /* Record command lines as line event names */
+} Trace;
+
+#define TRACE(tr, cat, ph, name) \
+    do { if ((tr) && (tr)->tr_on) Trace_event((tr), (cat), (ph), (name)); } while (0)
+
+Trace *Trace_new(size_t size, int lines);
+void Trace_free(Trace *tr);
+void Trace_event(Trace *tr, int cat, char ph, const char *name);
+PyObject *Trace_list(Trace *tr);
+
+#endif /* _PY_CLIGEN_TRACE_H_ */
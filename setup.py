@@ -19,8 +19,14 @@
 #  You should have received a copy of the GNU General Public License
 #  along with PyCLIgen; see the file LICENSE.
 
+import os
 from distutils.core import setup, Extension
 
+# Set PYCLIGEN_USDT=1 to compile in USDT probes, see pycligen_probes.h
+macros = []
+if os.environ.get('PYCLIGEN_USDT', '0') not in ('', '0'):
+    macros.append(('PYCLIGEN_USDT', None))
+
 long_desc = """The PyCLIgen bindings implements a Python API for the CLIgen library by Olof Hagsand."""
 
 setup(name = "pycligen",
@@ -35,7 +41,11 @@ setup(name = "pycligen",
       ext_modules = [
         Extension(
             "_cligen",
-            ["pycligen.c", "pycligen_cv.c", "pycligen_pt.c", "pycligen_cvec.c"],
+            ["pycligen.c", "pycligen_cv.c", "pycligen_pt.c", "pycligen_cvec.c",
+             "pycligen_output.c", "pycligen_stats.c",
+             "pycligen_trace.c", "pycligen_metrics.c",
+             "pycligen_mem.c"],
+            define_macros=macros,
             libraries=['cligen','python2.7'],
             )
         ]
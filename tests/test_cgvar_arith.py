@@ -0,0 +1,60 @@
+#!/usr/bin/env python
+#
+#  CgVar arithmetic regression tests
+#
+# Copyright (C) 2014-2015 Benny Holmgren
+#
+#  This file is part of PyCLIgen.
+#
+#  PyPyCLIgen is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation; either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  PyCLIgen is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with PyCLIgen; see the file LICENSE.
+
+"""Regression tests of CgVar arithmetic, run with:
+  PYTHONPATH=. python3 -m unittest discover tests
+"""
+
+import operator
+import unittest
+
+from cligen import *
+
+OPS = [operator.add, operator.sub, operator.mul, operator.truediv,
+       operator.iadd, operator.isub, operator.imul, operator.itruediv]
+
+
+class Dec64Arith(unittest.TestCase):
+
+    def check(self, other, ops):
+        for op in ops:
+            x = CgVar(CGV_DEC64, 'x', '1.5')
+            want = op(1.5, float(other))   # x has one decimal digit
+            self.assertAlmostEqual(float(op(x, other)), want, delta=0.06,
+                                   msg="{:s} {!r}".format(op.__name__, other))
+
+    def test_int(self):
+        # A Python int on the right has no CgVar to take dec64 digits from
+        self.check(2, OPS)
+
+    def test_float(self):
+        self.check(2.5, [operator.mul, operator.truediv,
+                         operator.imul, operator.itruediv])
+        for op in (operator.add, operator.sub, operator.iadd, operator.isub):
+            x = CgVar(CGV_DEC64, 'x', '1.5')
+            self.assertRaises(TypeError, op, x, 2.5)
+
+    def test_dec64(self):
+        self.check(CgVar(CGV_DEC64, 'y', '2.0'), OPS)
+
+
+if __name__ == '__main__':
+    unittest.main()
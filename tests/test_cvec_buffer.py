@@ -0,0 +1,77 @@
+#!/usr/bin/env python
+#
+#  Cvec buffer protocol regression tests
+#
+# Copyright (C) 2014-2015 Benny Holmgren
+#
+#  This file is part of PyCLIgen.
+#
+#  PyPyCLIgen is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation; either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  PyCLIgen is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with PyCLIgen; see the file LICENSE.
+
+
+"""Regression tests of the Cvec buffer protocol, run with:
+  PYTHONPATH=. python3 -m unittest discover tests
+"""
+
+import unittest
+
+from cligen import *
+
+
+def cvec(type, values):
+    vr = Cvec()
+    for i, value in enumerate(values):
+        vr.append(CgVar(type, 'v{:d}'.format(i), value))
+    return vr
+
+
+class Buffer(unittest.TestCase):
+
+    def test_int(self):
+        m = memoryview(cvec(CGV_INT32, ['1', '-2', '3']))
+        self.assertEqual((m.format, m.itemsize, m.ndim, m.readonly),
+                         ('i', 4, 1, True))
+        self.assertEqual(m.tolist(), [1, -2, 3])
+        m.release()
+
+    def test_ipv4(self):
+        m = memoryview(cvec(CGV_IPV4ADDR, ['10.0.0.1', '192.168.1.1']))
+        self.assertEqual(m.tolist(), [0x0a000001, 0xc0a80101])
+
+    def test_ipv6(self):
+        m = memoryview(cvec(CGV_IPV6ADDR, ['::1']))
+        self.assertEqual((m.shape, m.tobytes()), ((1, 16), b'\0' * 15 + b'\1'))
+
+    def test_snapshot(self):
+        vr = cvec(CGV_INT16, ['5'])
+        m = memoryview(vr)
+        vr[0] = '6'
+        self.assertEqual((m.tolist(), memoryview(vr).tolist()), ([5], [6]))
+
+    def test_empty(self):
+        self.assertEqual(len(memoryview(Cvec())), 0)
+
+    def test_mixed(self):
+        vr = cvec(CGV_INT32, ['1'])
+        vr.append(CgVar(CGV_INT64, 'x', '2'))
+        self.assertRaises(BufferError, memoryview, vr)
+        self.assertRaises(BufferError, memoryview, cvec(CGV_STRING, ['a']))
+
+    def test_readonly(self):
+        m = memoryview(cvec(CGV_INT32, ['1']))
+        self.assertRaises(TypeError, m.__setitem__, 0, 2)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,83 @@
+#!/usr/bin/env python
+#
+#  Cvec and CgVar wire format regression tests
+#
+# Copyright (C) 2014-2015 Benny Holmgren
+#
+#  This file is part of PyCLIgen.
+#
+#  PyPyCLIgen is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation; either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  PyCLIgen is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with PyCLIgen; see the file LICENSE.
+
+
+"""Regression tests of decoding the Cvec and CgVar wire format, run with:
+  PYTHONPATH=. python3 -m unittest discover tests
+"""
+
+import pickle
+import unittest
+
+from cligen import *
+
+
+class Decode(unittest.TestCase):
+
+    def cvec(self):
+        vr = Cvec()
+        vr.append(CgVar(CGV_INT32, 'a', '42'))
+        vr.append(CgVar(CGV_STRING, 'b', 'hello'))
+        vr.append(CgVar(CGV_IPV4PFX, 'c', '10.0.0.0/8'))
+        return vr
+
+    def test_roundtrip(self):
+        vr = decode(self.cvec().encode())
+        self.assertEqual([str(cv) for cv in vr], ['42', 'hello', '10.0.0.0/8'])
+        self.assertEqual(vr.keys(), ['a', 'b', 'c'])
+        cv = pickle.loads(pickle.dumps(CgVar(CGV_UINT16, 'x', '7')))
+        self.assertEqual((cv.name_get(), cv.type_get(), str(cv)),
+                         ('x', CGV_UINT16, '7'))
+
+    def test_truncated(self):
+        buf = self.cvec().encode()
+        for n in range(len(buf)):
+            self.assertRaises(ValueError, decode, buf[:n])
+
+    def test_oversized(self):
+        buf = CgVar(CGV_INT32, value='1').encode()
+        self.assertRaises(ValueError, decode, buf + b'\0')
+        # Value length of 5 bytes for an int32
+        n = len(buf) - 8
+        bad = buf[:n] + b'\x05\0\0\0' + buf[n + 4:] + b'\0'
+        self.assertRaises(ValueError, decode, bad)
+
+    def test_bad_type(self):
+        # Type is the first byte of the variable, 9 bytes before the value
+        buf = bytearray(CgVar(CGV_INT32, value='1').encode())
+        buf[-13] = 0xfe
+        self.assertRaises(ValueError, decode, bytes(buf))
+
+    def test_bad_value(self):
+        buf = bytearray(CgVar(CGV_IPV4PFX, value='10.0.0.0/8').encode())
+        buf[-1] = 33
+        self.assertRaises(ValueError, decode, bytes(buf))
+        buf = bytearray(CgVar(CGV_STRING, value='ab').encode())
+        buf[-1] = 0
+        self.assertRaises(ValueError, decode, bytes(buf))
+
+    def test_bad_argument(self):
+        self.assertRaises(TypeError, decode, 'CG')
+        self.assertRaises(TypeError, decode, 42)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,86 @@
+#!/usr/bin/env python
+#
+#  Cvec name index regression tests
+#
+# Copyright (C) 2014-2015 Benny Holmgren
+#
+#  This file is part of PyCLIgen.
+#
+#  PyPyCLIgen is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation; either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  PyCLIgen is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with PyCLIgen; see the file LICENSE.
+
+
+"""Regression tests of looking up Cvec variables by name, run with:
+  PYTHONPATH=. python3 -m unittest discover tests
+"""
+
+import unittest
+
+from cligen import *
+
+
+def cvec(*names):
+    vr = Cvec()
+    for i, name in enumerate(names):
+        vr.append(CgVar(CGV_INT32, name, str(i)))
+    return vr
+
+
+class Index(unittest.TestCase):
+
+    def test_lookup(self):
+        vr = cvec('a', 'b', 'a')
+        self.assertEqual((int(vr['a']), int(vr['b'])), (0, 1))
+        self.assertEqual((vr.index('b'), vr.index('c')), (1, None))
+        self.assertTrue('a' in vr)
+        self.assertFalse('c' in vr)
+        self.assertRaises(IndexError, vr.__getitem__, 'c')
+
+    def test_rename(self):
+        vr = cvec('a', 'b')
+        vr['a']
+        vr['b'].name_set('c')
+        self.assertFalse('b' in vr)
+        self.assertEqual(int(vr['c']), 1)
+        vr['a'].name_set('c')
+        self.assertEqual(vr.index('c'), 0)
+
+    def test_rename_outside(self):
+        cv = CgVar(CGV_INT32, 'a', '5')
+        vr = cvec('x')
+        vr.append(cv)
+        self.assertEqual(vr.index('a'), 1)
+        cv.name_set('b')
+        self.assertEqual((vr.index('a'), vr.index('b')), (None, 1))
+
+    def test_change(self):
+        vr = cvec('a', 'b', 'c')
+        vr['b']
+        del vr['a']
+        self.assertEqual(vr.index('b'), 0)
+        vr[0] = CgVar(CGV_INT32, 'd', '9')
+        self.assertEqual((vr.index('b'), int(vr['d'])), (None, 9))
+        vr.append(CgVar(CGV_INT32, 'e', '7'))
+        self.assertEqual(vr.index('e'), 2)
+
+    def test_list_copy(self):
+        vr = cvec('a', 'b')
+        vr['a']
+        vr._cvec.pop(0)
+        self.assertEqual(vr.index('a'), 0)
+        vr._cvec = [CgVar(CGV_INT32, 'x', '1')]
+        self.assertEqual((vr.index('a'), vr.index('x')), (None, 0))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,96 @@
+#!/usr/bin/env python
+#
+#  Cvec copy-on-write regression tests
+#
+# Copyright (C) 2014-2015 Benny Holmgren
+#
+#  This file is part of PyCLIgen.
+#
+#  PyPyCLIgen is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation; either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  PyCLIgen is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with PyCLIgen; see the file LICENSE.
+
+
+"""Regression tests of Cvec copies sharing their variables, run with:
+  PYTHONPATH=. python3 -m unittest discover tests
+"""
+
+import copy
+import unittest
+
+import _cligen
+from cligen import *
+
+
+def cvec(n):
+    vr = Cvec()
+    for i in range(n):
+        vr.append(CgVar(CGV_INT32, 'v{:d}'.format(i), str(i)))
+    return vr
+
+
+def values(vr):
+    return [int(cv) for cv in vr]
+
+
+class Share(unittest.TestCase):
+
+    def test_shared(self):
+        vr = cvec(4)
+        before = _cligen._memory()['cgvar']['count']
+        copies = [copy.copy(vr) for i in range(3)] + [vr + vr]
+        self.assertEqual(_cligen._memory()['cgvar']['count'], before)
+        self.assertEqual(values(copies[-1]), [0, 1, 2, 3] * 2)
+
+    def test_concat(self):
+        vr = cvec(2)
+        self.assertEqual(values(vr + vr), [0, 1, 0, 1])
+        vr += vr
+        self.assertEqual(values(vr), [0, 1, 0, 1])
+
+    def test_change_copy(self):
+        vr = cvec(3)
+        cp = copy.copy(vr)
+        cp[1] = '10'
+        cp['v2'].int32_set(20)
+        self.assertEqual(values(vr), [0, 1, 2])
+        self.assertEqual(values(cp), [0, 10, 20])
+
+    def test_change_original(self):
+        vr = cvec(3)
+        cp = vr + cvec(1)
+        for cv in vr:
+            cv.int32_set(int(cv) + 100)
+        self.assertEqual(values(vr), [100, 101, 102])
+        self.assertEqual(values(cp), [0, 1, 2, 0])
+
+    def test_held_outside(self):
+        vr = cvec(2)
+        cv = vr[0]
+        cp = copy.copy(vr)
+        cv.int32_set(5)
+        self.assertEqual((values(vr), values(cp)), ([5, 1], [0, 1]))
+
+    def test_identity(self):
+        vr = copy.copy(cvec(2))
+        self.assertIs(vr[0], vr[0])
+        self.assertIs(vr['v1'], vr[1])
+
+    def test_deepcopy(self):
+        vr = cvec(2)
+        cp = copy.deepcopy(vr)
+        cp[0] = '9'
+        self.assertEqual((values(vr), values(cp)), ([0, 1], [9, 1]))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,69 @@
+#!/usr/bin/env python
+#
+#  CLIgen.execute() regression tests
+#
+# Copyright (C) 2014-2015 Benny Holmgren
+#
+#  This file is part of PyCLIgen.
+#
+#  PyPyCLIgen is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation; either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  PyCLIgen is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with PyCLIgen; see the file LICENSE.
+
+
+"""Regression tests of CLIgen.execute() and its output capture, run with:
+  PYTHONPATH=. python3 -m unittest discover tests
+"""
+
+import io
+import sys
+import unittest
+
+from cligen import *
+
+
+# Callbacks are looked up in __main__
+def test_execute_cb(cligen, vr, arg):
+    cligen.output(test_execute_cb.file, "hello " + str(vr[1]) + "\n")
+    return 7
+
+
+class Execute(unittest.TestCase):
+
+    def setUp(self):
+        setattr(sys.modules['__main__'], 'test_execute_cb', test_execute_cb)
+        test_execute_cb.file = io.StringIO()
+        self.cligen = CLIgen('hello <name:string>, test_execute_cb();')
+
+    def tearDown(self):
+        delattr(sys.modules['__main__'], 'test_execute_cb')
+
+    def test_capture(self):
+        self.assertEqual(self.cligen.execute('hello world'),
+                         (7, 'hello world\n'))
+        self.assertEqual(test_execute_cb.file.getvalue(), '')
+
+    def test_no_capture(self):
+        self.assertEqual(self.cligen.execute('hello world', False), (7, None))
+        self.assertEqual(test_execute_cb.file.getvalue(), 'hello world\n')
+
+    def test_repeated(self):
+        for name in ('a', 'b'):
+            self.assertEqual(self.cligen.execute('hello ' + name)[1],
+                             'hello {:s}\n'.format(name))
+
+    def test_nomatch(self):
+        self.assertRaises(ValueError, self.cligen.execute, 'nomatch')
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,65 @@
+#!/usr/bin/env python
+#
+#  parse_bulk() regression tests
+#
+# Copyright (C) 2014-2015 Benny Holmgren
+#
+#  This file is part of PyCLIgen.
+#
+#  PyPyCLIgen is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation; either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  PyCLIgen is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with PyCLIgen; see the file LICENSE.
+
+
+"""Regression tests of parse_bulk(), run with:
+  PYTHONPATH=. python3 -m unittest discover tests
+"""
+
+import array
+import unittest
+
+from cligen import *
+
+
+class ParseBulk(unittest.TestCase):
+
+    def test_int(self):
+        values, errors = parse_bulk(CGV_INT32, ['1', 'x', '-3'])
+        self.assertEqual(values, array.array('i', [1, 0, -3]))
+        self.assertEqual(list(errors), [0, 1, 0])
+
+    def test_range(self):
+        values, errors = parse_bulk(CGV_UINT8, ('256', '255'))
+        self.assertEqual(values, array.array('B', [0, 255]))
+        self.assertEqual(list(errors), [1, 0])
+
+    def test_prefix(self):
+        (addrs, masks), errors = parse_bulk(CGV_IPV4PFX, ['10.0.0.0/8', 'bad'])
+        self.assertEqual(addrs, array.array('I', [0x0a000000, 0]))
+        self.assertEqual(masks, array.array('B', [8, 0]))
+        self.assertEqual(list(errors), [0, 1])
+
+    def test_string(self):
+        values, errors = parse_bulk(CGV_STRING, ['a', 'b'])
+        self.assertEqual([str(cv) for cv in values], ['a', 'b'])
+        self.assertEqual(list(errors), [0, 0])
+
+    def test_empty(self):
+        values, errors = parse_bulk(CGV_INT64, [])
+        self.assertEqual((len(values), len(errors)), (0, 0))
+
+    def test_not_sequence(self):
+        self.assertRaises(TypeError, parse_bulk, CGV_INT32, 42)
+
+
+if __name__ == '__main__':
+    unittest.main()